@@ -12,9 +12,18 @@
 #include <list>
 #include <algorithm>
 #include <memory>
+#include <chrono>
 using namespace std;
 #endif /* __PROGTEST__ */
 
+// Not among the headers provided by ProgTest
+#include <string_view>
+#include <array>
+#include <cstdint>
+#include <bitset>
+#include <new>
+#include <memory_resource>
+
 class CVATRegister
 {
 public:
@@ -23,6 +32,15 @@ public:
      */
      CVATRegister   ( void );
 
+    /**
+     * @brief Constructor, all storage of the register ( companies, indices, invoice history ) is drawn from given resource
+     * @param resource Memory resource, it has to outlive the register
+     * @param abandonOnDestroy True if the resource ignores deallocation and is released as a whole ( e.g. a monotonic arena ),
+     *        the destructor then skips destructors of companies and ledgers ( O(1) teardown ), so their memory is given back
+     *        only by release of the resource
+     */
+    explicit CVATRegister ( pmr::memory_resource * resource, bool abandonOnDestroy = false );
+
      /**
       * @brief Default destructor
       */
@@ -35,9 +53,9 @@ public:
      * @param taxID Company ID
      * @return True if the company was inserted successfully, otherwise False ( Company with same ID / Name + Address already exists )
      */
-    bool          newCompany     ( const string    & name,
-                                   const string    & addr,
-                                   const string    & taxID );
+    bool          newCompany     ( string_view       name,
+                                   string_view       addr,
+                                   string_view       taxID );
 
     /**
      * @brief Deletes a company with given name + address from register
@@ -45,15 +63,15 @@ public:
      * @param addr Company address
      * @return True if the deletion was successful, otherwise False ( Company with given name + address doesn't exist )
      */
-    bool          cancelCompany  ( const string    & name,
-                                   const string    & addr );
+    bool          cancelCompany  ( string_view       name,
+                                   string_view       addr );
 
     /**
      * @brief Deletes a company with given ID from register
      * @param taxID Company ID
      * @return True if the deletion was successful, otherwise False ( Company with given ID doesn't exist )
      */
-    bool          cancelCompany  ( const string    & taxID );
+    bool          cancelCompany  ( string_view       taxID );
 
     /**
      * @brief Records an income of a company with given ID
@@ -62,7 +80,7 @@ public:
      * @return True if the record was successful, otherwise False ( Company with given ID doesn't exist )
      */
 
-    bool          invoice        ( const string    & taxID,
+    bool          invoice        ( string_view       taxID,
                                    unsigned int      amount );
 
     /**
@@ -73,8 +91,8 @@ public:
      * @return True if the record was successful, otherwise False ( Company with given name + address doesn't exist )
      */
 
-    bool          invoice        ( const string    & name,
-                                   const string    & addr,
+    bool          invoice        ( string_view       name,
+                                   string_view       addr,
                                    unsigned int      amount );
 
     /**
@@ -85,8 +103,8 @@ public:
      * @return True if the Company with given name + address exists, otherwise False
      */
 
-    bool          audit          ( const string    & name,
-                                   const string    & addr,
+    bool          audit          ( string_view       name,
+                                   string_view       addr,
                                    unsigned int    & sumIncome ) const;
 
     /**
@@ -95,7 +113,7 @@ public:
      * @param sumIncome Sum of incomes
      * @return True if the Company with given ID exists, otherwise False
      */
-    bool          audit          ( const string    & taxID,
+    bool          audit          ( string_view       taxID,
                                    unsigned int    & sumIncome ) const;
     /**
      * @brief Finds the first company in register ( Sorted in alphabetical order by name + address )
@@ -121,349 +139,1676 @@ public:
      */
     unsigned int  medianInvoice  ( void ) const;
 
+    /**
+     * @brief Records a dated income of a company with given ID
+     * @param taxID Company ID
+     * @param amount Income amount
+     * @param date Day number of the invoice ( e.g. days since 2000-01-01 )
+     * @return True if the record was successful, otherwise False ( Company with given ID doesn't exist )
+     */
+    bool          invoice        ( string_view       taxID,
+                                   unsigned int      amount,
+                                   int               date );
+
+    /**
+     * @brief Records a dated income of a company with given name + address
+     * @param name Company Name
+     * @param addr Company address
+     * @param amount Income amount
+     * @param date Day number of the invoice ( e.g. days since 2000-01-01 )
+     * @return True if the record was successful, otherwise False ( Company with given name + address doesn't exist )
+     */
+    bool          invoice        ( string_view       name,
+                                   string_view       addr,
+                                   unsigned int      amount,
+                                   int               date );
+
+    /**
+     * @brief Counts a sum of dated incomes of a company with given ID, recorded in days from..to ( both inclusive )
+     * @param taxID Company ID
+     * @param from First day of the period
+     * @param to Last day of the period
+     * @param sumIncome Sum of incomes in the period
+     * @return True if the Company with given ID exists, otherwise False
+     */
+    bool          audit          ( string_view       taxID,
+                                   int               from,
+                                   int               to,
+                                   unsigned int    & sumIncome ) const;
+
+    /**
+     * @brief Counts a sum of dated incomes of a company with given name + address, recorded in days from..to ( both inclusive )
+     * @param name Company name
+     * @param addr Company address
+     * @param from First day of the period
+     * @param to Last day of the period
+     * @param sumIncome Sum of incomes in the period
+     * @return True if the Company with given name + address exists, otherwise False
+     */
+    bool          audit          ( string_view       name,
+                                   string_view       addr,
+                                   int               from,
+                                   int               to,
+                                   unsigned int    & sumIncome ) const;
+
+    /**
+     * @brief Finds the median of dated invoices recorded in days from..to ( both inclusive, even deleted companies )
+     * @param from First day of the period
+     * @param to Last day of the period
+     * @return Median value, if the number of invoices is even, function returns the greater value from 2 values in the middle ( default is 0 )
+     */
+    unsigned int  medianInvoice  ( int               from,
+                                   int               to ) const;
+
+    /**
+     * @brief Turns per-company invoice logs on / off, only invoices recorded while the logs are on are used by companyMedian
+     * @param enabled True to log amounts of every invoice to the history of its company
+     */
+    void          setCompanyLogs ( bool              enabled );
+
+    /**
+     * @brief Switches the global invoice history between a plain list of invoices and a run-length form
+     *        ( distinct amounts with their counts ), the already recorded invoices are converted in O(n log n).
+     *        In the run-length form an invoice of a known amount costs O(log d) for d distinct amounts, a new amount waits
+     *        in a sorted buffer of O(sqrt(d)) amounts, so it costs amortized O(sqrt(d)) and O(d) in the worst case
+     *        when the buffer is merged in
+     * @param enabled True for the run-length form, memory and median cost then depend on the number of distinct amounts only
+     */
+    void          setRunLengthHistory ( bool         enabled );
+
+    /**
+     * @brief Counts all recorded invoices of a company with given ID
+     * @param taxID Company ID
+     * @param count Number of invoices
+     * @return True if the Company with given ID exists, otherwise False
+     */
+    bool          companyCount   ( string_view       taxID,
+                                   unsigned int    & count ) const;
+
+    /**
+     * @brief Counts all recorded invoices of a company with given name + address
+     * @param name Company name
+     * @param addr Company address
+     * @param count Number of invoices
+     * @return True if the Company with given name + address exists, otherwise False
+     */
+    bool          companyCount   ( string_view       name,
+                                   string_view       addr,
+                                   unsigned int    & count ) const;
+
+    /**
+     * @brief Finds the greatest recorded invoice of a company with given ID
+     * @param taxID Company ID
+     * @param maxInvoice Greatest invoice ( 0 if there is none )
+     * @return True if the Company with given ID exists, otherwise False
+     */
+    bool          companyMax     ( string_view       taxID,
+                                   unsigned int    & maxInvoice ) const;
+
+    /**
+     * @brief Finds the greatest recorded invoice of a company with given name + address
+     * @param name Company name
+     * @param addr Company address
+     * @param maxInvoice Greatest invoice ( 0 if there is none )
+     * @return True if the Company with given name + address exists, otherwise False
+     */
+    bool          companyMax     ( string_view       name,
+                                   string_view       addr,
+                                   unsigned int    & maxInvoice ) const;
+
+    /**
+     * @brief Finds the median of logged invoices of a company with given ID
+     * @param taxID Company ID
+     * @param median Median value, the greater one of the 2 values in the middle for even count ( 0 if there is none )
+     * @return True if the Company with given ID exists, otherwise False
+     */
+    bool          companyMedian  ( string_view       taxID,
+                                   unsigned int    & median ) const;
+
+    /**
+     * @brief Finds the median of logged invoices of a company with given name + address
+     * @param name Company name
+     * @param addr Company address
+     * @param median Median value, the greater one of the 2 values in the middle for even count ( 0 if there is none )
+     * @return True if the Company with given name + address exists, otherwise False
+     */
+    bool          companyMedian  ( string_view       name,
+                                   string_view       addr,
+                                   unsigned int    & median ) const;
+
 
 private:
 
+    /**
+     * @brief Size of one block of the per-company invoice log
+     */
+    static const size_t LOG_CHUNK = 64;
+
+    /**
+     * @brief Pending amounts of the run-length history are merged once there are more than PENDING_SCALE * sqrt(d) of them
+     */
+    static const size_t PENDING_SCALE = 4;
+
+    /**
+     * @brief Number of levels of the wavelet matrix over invoice amounts, one per bit
+     */
+    static const int LEVELS = 32;
+
+    /**
+     * @brief Number of runs of the same size merged into one in the global dated history
+     */
+    static const size_t MERGE_WAYS = 8;
+
+    /**
+     * @brief Upper bound of the number of runs of the global dated history, MERGE_WAYS - 1 per digit of the count in base 8
+     */
+    static const size_t MAX_RUNS = ( MERGE_WAYS - 1 ) * ( 64 / 3 + 1 );
+
+    /**
+     * @brief Dated entry of a history, the value is an amount or a prefix sum of amounts
+     */
+    struct Dated {
+        int date;
+        unsigned int value;
+    };
+
+    /**
+     * @brief History of one company. Dated invoices in runs sorted by date with prefix sums of their amounts in every run,
+     *        invoice statistics and optional log of amounts ( zigzag deltas of consecutive amounts as varints, in fixed-size chunks )
+     */
+    struct Ledger {
+
+        using allocator_type = pmr::polymorphic_allocator<char>;
+
+        explicit Ledger ( const allocator_type & alloc = {} )
+            : dated ( alloc ), log ( alloc )
+        {
+        }
+
+        Ledger ( const Ledger & other, const allocator_type & alloc )
+            : dated ( other.dated, alloc ),
+              count ( other.count ), maxInvoice ( other.maxInvoice ),
+              log ( other.log, alloc ), logBytes ( other.logBytes ), logCount ( other.logCount ), logLast ( other.logLast )
+        {
+        }
+
+        Ledger ( Ledger && other, const allocator_type & alloc )
+            : dated ( std::move( other.dated ), alloc ),
+              count ( other.count ), maxInvoice ( other.maxInvoice ),
+              log ( std::move( other.log ), alloc ), logBytes ( other.logBytes ), logCount ( other.logCount ), logLast ( other.logLast )
+        {
+        }
+
+        Ledger ( const Ledger & other ) = default;
+        Ledger ( Ledger && other ) = default;
+        Ledger & operator = ( const Ledger & other ) = default;
+        Ledger & operator = ( Ledger && other ) = default;
+
+        pmr::vector<Dated> dated;
+
+        unsigned int count = 0;
+        unsigned int maxInvoice = 0;
+
+        pmr::vector<array<unsigned char, LOG_CHUNK>> log;
+        size_t logBytes = 0;
+        unsigned int logCount = 0;
+        unsigned int logLast = 0;
+    };
+
+    /**
+     * @brief Word of one level of the wavelet matrix, 64 bits of the level and number of ones before them
+     */
+    struct LevelWord {
+        uint64_t bits = 0;
+        size_t ones = 0;
+    };
+
+    /**
+     * @brief Run of the global dated history, sorted by date with its own wavelet matrix over amounts
+     */
+    struct Run {
+        size_t start;
+        size_t size;
+        array<size_t, LEVELS> zeros;
+    };
+
     /**
      * @brief Struct representing an instance of company in register
      */
 
     struct Company {
 
-        Company ( const string & name, const string & address, const string & id )
+        using allocator_type = pmr::polymorphic_allocator<char>;
+
+        Company ( string_view name, string_view address, string_view id, const allocator_type & alloc = {} )
+            : name ( name, alloc ), address ( address, alloc ), id ( id, alloc )
+        {
+        }
+
+        Company ( const Company & other, const allocator_type & alloc )
+            : name ( other.name, alloc ), address ( other.address, alloc ), id ( other.id, alloc ),
+              income ( other.income ), ledger ( other.ledger )
+        {
+        }
+
+        Company ( Company && other, const allocator_type & alloc )
+            : name ( std::move( other.name ), alloc ), address ( std::move( other.address ), alloc ), id ( std::move( other.id ), alloc ),
+              income ( other.income ), ledger ( other.ledger )
         {
-            this->name = name;
-            this->address = address;
-            this->id = id;
         }
 
-        string name ;
-        string address ;
-        string id ;
+        Company ( const Company & other ) = default;
+        Company ( Company && other ) = default;
+        Company & operator = ( const Company & other ) = default;
+        Company & operator = ( Company && other ) = default;
+
+        pmr::string name ;
+        pmr::string address ;
+        pmr::string id ;
         unsigned int income = 0;
+        size_t ledger = 0;
     };
 
     /**
      * @brief All companies sorted by their IDs
      */
-    vector<Company> sortedById;
+    pmr::vector<Company> sortedById;
 
     /**
      * @brief All companies sorted by their names + addresses
      */
-    vector<Company> sortedByName;
+    pmr::vector<Company> sortedByName;
 
     /**
      * @brief All invoices of all companies in register history
      */
-    vector<unsigned int> invoices;
+    pmr::vector<unsigned int> invoices;
+
+    /**
+     * @brief True if the global invoice history is kept in the run-length form instead of invoices
+     */
+    bool runLength = false;
+
+    /**
+     * @brief Run-length history, distinct amounts of all invoices in ascending order
+     */
+    pmr::vector<unsigned int> distinctAmounts;
+
+    /**
+     * @brief Run-length history, number of invoices of every distinct amount
+     */
+    pmr::vector<unsigned int> amountCounts;
+
+    /**
+     * @brief Run-length history, Fenwick tree over amountCounts for rank queries
+     */
+    pmr::vector<unsigned int> rankTree;
+
+    /**
+     * @brief Run-length history, invoices of amounts missing in distinctAmounts in ascending order,
+     *        merged into distinctAmounts once there are more than PENDING_SCALE * sqrt(d) of them
+     */
+    pmr::vector<unsigned int> pendingAmounts;
+
+    /**
+     * @brief Run-length history, total number of invoices
+     */
+    unsigned int historyCount = 0;
+
+    /**
+     * @brief Dated histories of companies, indexed by Company::ledger
+     */
+    pmr::vector<Ledger> ledgers;
+
+    /**
+     * @brief Ledger slots released by cancelled companies
+     */
+    pmr::vector<size_t> freeLedgers;
+
+    /**
+     * @brief Memory resource of all containers of the register
+     */
+    pmr::memory_resource * resource;
+
+    /**
+     * @brief True if the destructor leaves companies and ledgers in the resource instead of destroying them
+     */
+    bool abandonOnDestroy;
+
+    /**
+     * @brief Dates of all dated invoices in runs sorted by date. Sizes of the runs are the digits of the count in base
+     *        MERGE_WAYS ( largest first ), a new invoice merges the runs it carries into, so any invoice costs amortized
+     *        O(log n) regardless of the order of dates
+     */
+    pmr::vector<int> datedDates;
+
+    /**
+     * @brief Wavelet matrix of amounts of every run, level i holds bit 31 - i of the amounts
+     */
+    pmr::vector<pmr::vector<LevelWord>> levels;
+
+    /**
+     * @brief Runs of the global dated history in the order of datedDates
+     */
+    pmr::vector<Run> runs;
+
+    /**
+     * @brief True if amounts of invoices are logged to the ledgers of companies
+     */
+    bool companyLogs = false;
+
+    /**
+     * @brief Updates the statistics of a company and appends the amount to its log ( if logs are on )
+     * @param ledger Ledger slot of the company
+     * @param amount Income amount
+     */
+    void recordCompany ( size_t ledger, unsigned int amount );
+
+    /**
+     * @brief Moves a container to a block drawn from the resource, which is never destroyed ( teardown with abandonOnDestroy )
+     * @param container Container to be abandoned, it is left empty
+     */
+    template <typename Container>
+    void abandon ( Container & container );
+
+    /**
+     * @brief Decodes the log of a company
+     * @param ledger Ledger slot of the company
+     * @return All logged amounts in order of recording
+     */
+    vector<unsigned int> decodeLog ( size_t ledger ) const;
+
+    /**
+     * @brief Finds the median of logged invoices of a company
+     * @param ledger Ledger slot of the company
+     * @return Median value ( 0 if there is none )
+     */
+    unsigned int logMedian ( size_t ledger ) const;
+
+    /**
+     * @brief Records an invoice to the global history
+     * @param amount Income amount
+     */
+    void recordHistory ( unsigned int amount );
+
+    /**
+     * @brief Adds an invoice to the run-length history
+     * @param amount Income amount
+     */
+    void addRunLength ( unsigned int amount );
+
+    /**
+     * @brief Merges pendingAmounts into distinctAmounts and amountCounts
+     */
+    void mergePendingAmounts ( void );
 
     /**
-     * @brief Converts a string to lowercase
-     * @param text String to be converted
+     * @brief Builds the Fenwick tree over amountCounts in linear time
      */
+    void buildRankTree ( void );
 
-    static void toLowerCase ( string & text );
+    /**
+     * @brief Finds the median of the run-length history by a descent in the Fenwick tree, counting pendingAmounts on the way
+     * @return Median value ( 0 if there are no invoices )
+     */
+    unsigned int runLengthMedian ( void ) const;
+
+    /**
+     * @brief Books an invoice to a company, both copies of the company are updated
+     * @param byId Company in sortedById
+     * @param byName Company in sortedByName
+     * @param amount Income amount
+     */
+    void book ( Company & byId, Company & byName, unsigned int amount );
+
+    /**
+     * @brief Finds the company with given ID
+     * @param id Company ID
+     * @return Iterator to the company in sortedById, or end() if it doesn't exist
+     */
+    pmr::vector<Company>::const_iterator findById ( string_view id ) const;
+
+    /**
+     * @brief Finds the company with given name + address
+     * @param name Company name
+     * @param address Company address
+     * @return Iterator to the company in sortedByName, or end() if it doesn't exist
+     */
+    pmr::vector<Company>::const_iterator findByName ( string_view name, string_view address ) const;
+
+    /**
+     * @brief Records a dated invoice to the ledger of a company and to the global dated history
+     * @param ledger Ledger slot of the company
+     * @param amount Income amount
+     * @param date Day number of the invoice
+     */
+    void recordDated ( size_t ledger, unsigned int amount, int date );
+
+    /**
+     * @brief Counts a sum of ledger entries in days from..to
+     * @param ledger Ledger slot of the company
+     * @param from First day of the period
+     * @param to Last day of the period
+     * @return Sum of incomes in the period
+     */
+    unsigned int ledgerSum ( size_t ledger, int from, int to ) const;
+
+    /**
+     * @brief Size of the first run of the rest of a dated history
+     * @param remaining Number of entries from the start of the run to the end of the history
+     * @return The highest power of 2 not above remaining
+     */
+    static size_t runSize ( size_t remaining );
+
+    /**
+     * @brief Merges the runs at the end of a dated history into one run sorted by date
+     * @param tail First entry of the runs, they have sizes size / 2, size / 4, ... 1 and the new entry is the last one
+     * @param size Number of entries, a power of 2
+     */
+    static void mergeRuns ( Dated * tail, size_t size );
+
+    /**
+     * @brief Counts ones of a level of the wavelet matrix before a position
+     * @param level Level of the matrix
+     * @param pos Position in the level
+     * @return Number of ones in [ 0, pos )
+     */
+    size_t onesBefore ( int level, size_t pos ) const;
+
+    /**
+     * @brief Reads all amounts of a run from the wavelet matrix
+     * @param run Run of the global dated history
+     * @param amounts Amounts of the run in order by date are appended
+     */
+    void runAmounts ( const Run & run, vector<unsigned int> & amounts ) const;
+
+    /**
+     * @brief Writes the wavelet matrix of the last run, the run ends at the end of the dated history
+     * @param entries Dated amounts of the run sorted by date
+     */
+    void buildRun ( const vector<Dated> & entries );
+
+    /**
+     * @brief Compares two strings case insensitive, without any copies
+     * @param text1 First string
+     * @param text2 Second string
+     * @return Negative if text1 < text2, 0 if they are equal, otherwise positive
+     */
+    static int compareNoCase ( string_view text1, string_view text2 );
+
+    /**
+     * @brief Lookup key of a company by name + address, it only refers to the caller's strings
+     */
+    struct NameKey {
+        string_view name;
+        string_view address;
+    };
+
+    /**
+     * @brief Compare function for companies and IDs ( transparent, lookups don't need a temporary company )
+     */
+    struct CompareById {
+
+        using is_transparent = void;
+
+        bool operator () ( const Company & company1, const Company & company2 ) const { return company1.id < company2.id; }
+        bool operator () ( const Company & company, string_view id ) const { return string_view( company.id ) < id; }
+        bool operator () ( string_view id, const Company & company ) const { return id < string_view( company.id ); }
+    };
+
+    /**
+     * @brief Compare function for companies and name + address keys. Compares names, eventually addresses, if the names are the same ( both case insensitive )
+     */
+    struct CompareByName {
+
+        using is_transparent = void;
+
+        static bool less ( string_view name1, string_view address1, string_view name2, string_view address2 )
+        {
+            int byName = compareNoCase( name1, name2 );
+            return byName ? byName < 0 : compareNoCase( address1, address2 ) < 0;
+        }
+
+        bool operator () ( const Company & company1, const Company & company2 ) const { return less( company1.name, company1.address, company2.name, company2.address ); }
+        bool operator () ( const Company & company, const NameKey & key ) const { return less( company.name, company.address, key.name, key.address ); }
+        bool operator () ( const NameKey & key, const Company & company ) const { return less( key.name, key.address, company.name, company.address ); }
+    };
+
+    /**
+     * @brief Checks, whether the company with given id exists
+     * @param id Company ID
+     * @return true if the company exists, otherwise false
+     */
+
+    bool isIncluded ( string_view id ) const;
+
+    /**
+     * @brief @brief Checks, whether the company with given name + address exists
+     * @param name Company name
+     * @param address Company address
+     * @return true if the company exists, otherwise false
+     */
+
+    bool isIncluded ( string_view name, string_view address ) const;
+
+};
+
+bool CVATRegister::newCompany( string_view name, string_view addr, string_view taxID )
+{
+    if ( isIncluded( taxID ) || isIncluded( name, addr ))
+    {
+        return false ;
+    }
+
+    Company newCompanyToInsert ( name, addr, taxID, resource );
+
+    // Find the positions, where should be the new company inserted
+
+    auto positionByName = lower_bound( sortedByName.begin(), sortedByName.end(), newCompanyToInsert, CompareByName() );
+
+    auto positionById = lower_bound ( sortedById.begin(), sortedById.end(), newCompanyToInsert, CompareById() );
+
+    // Reserve a ledger for dated invoices of the company
+    if ( freeLedgers.empty() )
+    {
+        newCompanyToInsert.ledger = ledgers.size();
+        ledgers.emplace_back();
+    }
+    else
+    {
+        newCompanyToInsert.ledger = freeLedgers.back();
+        freeLedgers.pop_back();
+    }
+
+    // Inserting the companies to register
+    sortedById.insert  (positionById,   newCompanyToInsert );
+    sortedByName.insert(positionByName, newCompanyToInsert );
+
+    return true;
+}
+
+bool CVATRegister::cancelCompany( string_view name, string_view addr )
+{
+    // Find position of company in vector sorted by names + addresses
+    auto posByName = lower_bound(sortedByName.begin(), sortedByName.end(), NameKey { name, addr }, CompareByName() );
+
+    if ( posByName == sortedByName.end() || CompareByName()( NameKey { name, addr }, *posByName ) )
+    {
+        return false ;
+    }
+
+    // Find position of company in vector sorted by ID's. Using the previously found company
+    auto posById = lower_bound( sortedById.begin(), sortedById.end(), *posByName, CompareById() );
+
+    // Release the ledger of the company ( invoices stay in the global history )
+    ledgers[posByName->ledger] = Ledger( resource );
+    freeLedgers.push_back( posByName->ledger );
+
+    // Deleting the company
+    sortedByName.erase( posByName );
+    sortedById.  erase(posById );
+
+    return true;
+}
+
+bool CVATRegister::cancelCompany( string_view taxID )
+{
+    // Find position of company in vector sorted by ID's.
+    auto posById = lower_bound( sortedById.begin(), sortedById.end(), taxID, CompareById() );
+
+    if ( posById == sortedById.end() || posById->id != taxID )
+    {
+        return false ;
+    }
+
+    // Find position of company in vector sorted by names + addresses. Using the previously found company.
+    auto posByName = lower_bound(sortedByName.begin(), sortedByName.end(), *posById, CompareByName() );
+
+    // Release the ledger of the company ( invoices stay in the global history )
+    ledgers[posById->ledger] = Ledger( resource );
+    freeLedgers.push_back( posById->ledger );
+
+    // Deleting the company
+    sortedById.erase(posById);
+    sortedByName.erase(posByName);
+
+    return true;
+
+}
+
+bool CVATRegister::invoice( string_view taxID, unsigned int amount )
+{
+    // Find position of company in vector sorted by ID's.
+    auto posById = lower_bound( sortedById.begin(), sortedById.end(), taxID, CompareById() );
+
+    if ( posById == sortedById.end() || posById->id != taxID )
+    {
+        return false ;
+    }
+
+    // Find position of company in vector sorted by names + addresses. Using the previously found company.
+    auto posByName = lower_bound(sortedByName.begin(), sortedByName.end(), *posById, CompareByName() );
+
+    book( *posById, *posByName, amount );
+    return true;
+}
+
+bool CVATRegister::invoice( string_view name, string_view addr, unsigned int amount ) {
+
+    // Find position of company in vector sorted by names + addresses
+    auto posByName = lower_bound(sortedByName.begin(), sortedByName.end(), NameKey { name, addr }, CompareByName() );
+
+    if ( posByName == sortedByName.end() || CompareByName()( NameKey { name, addr }, *posByName ) )
+    {
+        return false ;
+    }
+
+    // Find position of company in vector sorted by ID's. Using the previously found company
+    auto posById = lower_bound( sortedById.begin(), sortedById.end(), *posByName, CompareById() );
+
+    book( *posById, *posByName, amount );
+    return true;
+}
+
+bool CVATRegister::audit( string_view name, string_view addr, unsigned int &sumIncome ) const
+{
+    auto posByName = findByName( name, addr );
+
+    if ( posByName == sortedByName.end() )
+    {
+        return false ;
+    }
+
+    sumIncome = posByName->income;
+    return true;
+
+}
+
+bool CVATRegister::audit( string_view taxID, unsigned int &sumIncome ) const
+{
+    auto posById = findById( taxID );
+
+    if ( posById == sortedById.end() )
+    {
+        return false ;
+    }
+
+    sumIncome = posById->income;
+    return true;
+}
+
+bool CVATRegister::firstCompany(string &name, string &addr) const
+{
+    // Check if there are any companies
+    if ( sortedByName.empty())
+    {
+        return false;
+    }
+
+    // Return first of them in vector sorted by names + addresses
+    name = sortedByName[0].name;
+    addr = sortedByName[0].address;
+    return true;
+}
+
+bool CVATRegister::nextCompany(string &name, string &addr) const
+{
+    // Check if there are any companies
+    if ( sortedByName.empty())
+    {
+        return false;
+    }
+
+    // Find the first company, after the company with given name and address
+    auto pos = upper_bound(sortedByName.begin(), sortedByName.end(), NameKey { name, addr }, CompareByName() );
+
+    // No company found
+    if ( pos == sortedByName.end() )
+    {
+        return false;
+    }
+
+    name = pos->name;
+    addr = pos->address;
+    return true;
+}
+
+unsigned int CVATRegister::medianInvoice(void) const
+{
+    if ( runLength )
+    {
+        return runLengthMedian();
+    }
+
+    // Default return value is 0
+    if ( invoices.empty() )
+    {
+        return 0;
+    }
+
+    // Sort all of the invoices
+    vector<unsigned int> tmpInvoices ( invoices.begin(), invoices.end() );
+    sort (tmpInvoices.begin(), tmpInvoices.end());
+
+    // If the number of invoices is odd, return the middle one
+    if ( invoices.size() % 2 )
+    {
+        return tmpInvoices[floor(invoices.size()/2)];
+    }
+
+    // Else return the greater value from the 2 values in the middle ( Vector is sorted in ascending order -> the greater index )
+    else
+    {
+        return tmpInvoices[(invoices.size()/2)];
+    }
+}
+
+void CVATRegister::setRunLengthHistory( bool enabled )
+{
+    if ( enabled == runLength )
+    {
+        return;
+    }
+
+    if ( enabled )
+    {
+        // Fold the plain history into distinct amounts in one pass over the sorted invoices
+        vector<unsigned int> sorted ( invoices.begin(), invoices.end() );
+        sort( sorted.begin(), sorted.end() );
+        for ( unsigned int amount : sorted )
+        {
+            if ( distinctAmounts.empty() || distinctAmounts.back() != amount )
+            {
+                distinctAmounts.push_back( amount );
+                amountCounts.push_back( 0 );
+            }
+            ++amountCounts.back();
+        }
+        historyCount = sorted.size();
+        buildRankTree();
+        invoices.clear();
+        invoices.shrink_to_fit();
+    }
+    else
+    {
+        // Unfold the distinct amounts, the original order isn't needed by the median
+        invoices.reserve( historyCount );
+        for ( size_t i = 0; i < distinctAmounts.size(); ++i )
+        {
+            invoices.insert( invoices.end(), amountCounts[i], distinctAmounts[i] );
+        }
+        invoices.insert( invoices.end(), pendingAmounts.begin(), pendingAmounts.end() );
+        distinctAmounts.clear();
+        amountCounts.clear();
+        rankTree.clear();
+        pendingAmounts.clear();
+        historyCount = 0;
+    }
+
+    runLength = enabled;
+}
+
+void CVATRegister::recordHistory( unsigned int amount )
+{
+    if ( runLength )
+    {
+        addRunLength( amount );
+    }
+    else
+    {
+        invoices.push_back( amount );
+    }
+}
+
+void CVATRegister::addRunLength( unsigned int amount )
+{
+    auto pos = lower_bound( distinctAmounts.begin(), distinctAmounts.end(), amount );
+    ++historyCount;
+
+    // Known amount, only its count grows
+    if ( pos != distinctAmounts.end() && *pos == amount )
+    {
+        size_t index = pos - distinctAmounts.begin();
+        ++amountCounts[index];
+        for ( size_t i = index + 1; i <= rankTree.size(); i += i & ( - i ) )
+        {
+            ++rankTree[i - 1];
+        }
+        return;
+    }
+
+    // New amount waits in the buffer, the distinct amounts are rebuilt only when the buffer outgrows PENDING_SCALE * sqrt(d)
+    pendingAmounts.insert( upper_bound( pendingAmounts.begin(), pendingAmounts.end(), amount ), amount );
+    if ( pendingAmounts.size() * pendingAmounts.size() > PENDING_SCALE * PENDING_SCALE * distinctAmounts.size() )
+    {
+        mergePendingAmounts();
+    }
+}
+
+void CVATRegister::mergePendingAmounts( void )
+{
+    pmr::vector<unsigned int> amounts ( resource );
+    pmr::vector<unsigned int> counts ( resource );
+    amounts.reserve( distinctAmounts.size() + pendingAmounts.size() );
+    counts.reserve( distinctAmounts.size() + pendingAmounts.size() );
+
+    // Pending amounts are never among the distinct ones, equal pending amounts make one entry
+    size_t known = 0;
+    for ( size_t i = 0; i < pendingAmounts.size(); ++i )
+    {
+        if ( i && pendingAmounts[i] == pendingAmounts[i - 1] )
+        {
+            ++counts.back();
+            continue;
+        }
+        for ( ; known < distinctAmounts.size() && distinctAmounts[known] < pendingAmounts[i]; ++known )
+        {
+            amounts.push_back( distinctAmounts[known] );
+            counts.push_back( amountCounts[known] );
+        }
+        amounts.push_back( pendingAmounts[i] );
+        counts.push_back( 1 );
+    }
+    amounts.insert( amounts.end(), distinctAmounts.begin() + known, distinctAmounts.end() );
+    counts.insert( counts.end(), amountCounts.begin() + known, amountCounts.end() );
+
+    distinctAmounts = std::move( amounts );
+    amountCounts = std::move( counts );
+    pendingAmounts.clear();
+    buildRankTree();
+}
+
+void CVATRegister::buildRankTree( void )
+{
+    rankTree.assign( amountCounts.begin(), amountCounts.end() );
+    for ( size_t i = 1; i <= rankTree.size(); ++i )
+    {
+        size_t parent = i + ( i & ( - i ) );
+        if ( parent <= rankTree.size() )
+        {
+            rankTree[parent - 1] += rankTree[i - 1];
+        }
+    }
+}
+
+unsigned int CVATRegister::runLengthMedian( void ) const
+{
+    if ( historyCount == 0 )
+    {
+        return 0;
+    }
+
+    // Find the first distinct amount with more than historyCount / 2 invoices ( pending ones too ) before and at it
+    unsigned int rank = historyCount / 2;
+    unsigned int taken = 0;
+    size_t pos = 0;
+    size_t step = 1;
+    while ( step * 2 <= rankTree.size() ) { step *= 2; }
+
+    for ( ; step; step /= 2 )
+    {
+        if ( pos + step > rankTree.size() )
+        {
+            continue;
+        }
+        size_t pending = upper_bound( pendingAmounts.begin(), pendingAmounts.end(), distinctAmounts[pos + step - 1] )
+                         - pendingAmounts.begin();
+        if ( taken + rankTree[pos + step - 1] + pending <= rank )
+        {
+            pos += step;
+            taken += rankTree[pos - 1];
+        }
+    }
+
+    // The median is this amount or one of the pending amounts right before it
+    auto first = pos ? upper_bound( pendingAmounts.begin(), pendingAmounts.end(), distinctAmounts[pos - 1] )
+                     : pendingAmounts.begin();
+    auto last = pos < distinctAmounts.size() ? lower_bound( first, pendingAmounts.end(), distinctAmounts[pos] )
+                                             : pendingAmounts.end();
+    size_t rest = rank - taken - ( first - pendingAmounts.begin() );
+    if ( rest < (size_t) ( last - first ) )
+    {
+        return first[rest];
+    }
+    return distinctAmounts[pos];
+}
+
+bool CVATRegister::invoice( string_view taxID, unsigned int amount, int date )
+{
+    auto posById = lower_bound( sortedById.begin(), sortedById.end(), taxID, CompareById() );
+
+    if ( posById == sortedById.end() || posById->id != taxID )
+    {
+        return false ;
+    }
+
+    auto posByName = lower_bound(sortedByName.begin(), sortedByName.end(), *posById, CompareByName() );
+
+    // Undated bookkeeping ( income, global median ) is the same as for a plain invoice
+    book( *posById, *posByName, amount );
+    recordDated( posById->ledger, amount, date );
+
+    return true;
+}
+
+bool CVATRegister::invoice( string_view name, string_view addr, unsigned int amount, int date )
+{
+    auto posByName = lower_bound(sortedByName.begin(), sortedByName.end(), NameKey { name, addr }, CompareByName() );
+
+    if ( posByName == sortedByName.end() || CompareByName()( NameKey { name, addr }, *posByName ) )
+    {
+        return false ;
+    }
+
+    auto posById = lower_bound( sortedById.begin(), sortedById.end(), *posByName, CompareById() );
+
+    // Undated bookkeeping ( income, global median ) is the same as for a plain invoice
+    book( *posById, *posByName, amount );
+    recordDated( posByName->ledger, amount, date );
+
+    return true;
+}
+
+bool CVATRegister::audit( string_view taxID, int from, int to, unsigned int &sumIncome ) const
+{
+    auto posById = findById( taxID );
+
+    if ( posById == sortedById.end() )
+    {
+        return false ;
+    }
+
+    sumIncome = ledgerSum( posById->ledger, from, to );
+    return true;
+}
+
+bool CVATRegister::audit( string_view name, string_view addr, int from, int to, unsigned int &sumIncome ) const
+{
+    auto posByName = findByName( name, addr );
+
+    if ( posByName == sortedByName.end() )
+    {
+        return false ;
+    }
+
+    sumIncome = ledgerSum( posByName->ledger, from, to );
+    return true;
+}
+
+unsigned int CVATRegister::medianInvoice( int from, int to ) const
+{
+    // Invoices of the period in every run
+    size_t lo[MAX_RUNS], hi[MAX_RUNS];
+    size_t count = 0;
+
+    for ( size_t run = 0; run < runs.size(); ++run )
+    {
+        auto first = datedDates.begin() + runs[run].start, last = first + runs[run].size;
+        lo[run] = runs[run].start + ( lower_bound( first, last, from ) - first );
+        hi[run] = max( lo[run], runs[run].start + ( upper_bound( first, last, to ) - first ) );
+        count += hi[run] - lo[run];
+    }
+
+    if ( count == 0 )
+    {
+        return 0;
+    }
+
+    // Index of the median ( the greater one of the 2 middle values for even count )
+    size_t rank = count / 2;
+    unsigned int result = 0;
+
+    // Walk all runs down the wavelet matrix at once, a zero bit keeps the invoices with zero in the level
+    for ( int level = 0; level < LEVELS; ++level )
+    {
+        size_t onesLo[MAX_RUNS], onesHi[MAX_RUNS];
+        size_t zeros = 0;
+
+        for ( size_t run = 0; run < runs.size(); ++run )
+        {
+            size_t base = onesBefore( level, runs[run].start );
+            onesLo[run] = onesBefore( level, lo[run] ) - base;
+            onesHi[run] = onesBefore( level, hi[run] ) - base;
+            zeros += ( hi[run] - lo[run] ) - ( onesHi[run] - onesLo[run] );
+        }
 
-    /**
-     * @brief Compare function for companies. Compares names, eventually addresses, if the names are the same ( both case insensitive )
-     * @param company1 First company
-     * @param company2 Second company
-     * @return True if the 1st company name < 2nd company name or == and 1st company address < 2nd company address, otherwise false
-     */
+        bool one = rank >= zeros;
+        if ( one )
+        {
+            rank -= zeros;
+            result |= 1u << ( LEVELS - 1 - level );
+        }
 
-    static bool compareFunction ( Company company1, Company company2 );
+        for ( size_t run = 0; run < runs.size(); ++run )
+        {
+            // Zeros of a run come first in the next level, ones after them
+            size_t start = runs[run].start;
+            lo[run] = one ? start + runs[run].zeros[level] + onesLo[run] : lo[run] - onesLo[run];
+            hi[run] = one ? start + runs[run].zeros[level] + onesHi[run] : hi[run] - onesHi[run];
+        }
+    }
 
-    /**
-     * @brief Checks, whether the company with given id exists
-     * @param id Company ID
-     * @return true if the company exists, otherwise false
-     */
+    return result;
+}
 
-    bool isIncluded ( const string & id ) const;
+void CVATRegister::setCompanyLogs( bool enabled )
+{
+    companyLogs = enabled;
+}
 
-    /**
-     * @brief @brief Checks, whether the company with given name + address exists
-     * @param name Company name
-     * @param address Company address
-     * @return true if the company exists, otherwise false
-     */
+bool CVATRegister::companyCount( string_view taxID, unsigned int &count ) const
+{
+    auto posById = findById( taxID );
 
-    bool isIncluded ( const string & name, const string & address ) const;
+    if ( posById == sortedById.end() )
+    {
+        return false ;
+    }
 
-};
+    count = ledgers[posById->ledger].count;
+    return true;
+}
 
-bool CVATRegister::newCompany( const string &name, const string &addr, const string &taxID )
+bool CVATRegister::companyCount( string_view name, string_view addr, unsigned int &count ) const
 {
-    Company newCompanyToInsert ( name, addr, taxID );
+    auto posByName = findByName( name, addr );
 
-    if ( isIncluded( taxID ) || isIncluded( name, addr ))
+    if ( posByName == sortedByName.end() )
     {
         return false ;
     }
 
-    // Find the positions, where should be the new company inserted
-
-    auto positionByName = lower_bound( sortedByName.begin(), sortedByName.end(), newCompanyToInsert, compareFunction );
+    count = ledgers[posByName->ledger].count;
+    return true;
+}
 
-    auto positionById = lower_bound ( sortedById.begin(), sortedById.end(), newCompanyToInsert,  [] ( const Company & company1, const Company & company2) {
-        return company1.id < company2.id;
-    } );
+bool CVATRegister::companyMax( string_view taxID, unsigned int &maxInvoice ) const
+{
+    auto posById = findById( taxID );
 
-    // Inserting the companies to register
-    sortedById.insert  (positionById,   newCompanyToInsert );
-    sortedByName.insert(positionByName, newCompanyToInsert );
+    if ( posById == sortedById.end() )
+    {
+        return false ;
+    }
 
+    maxInvoice = ledgers[posById->ledger].maxInvoice;
     return true;
 }
 
-bool CVATRegister::cancelCompany( const string &name, const string &addr )
+bool CVATRegister::companyMax( string_view name, string_view addr, unsigned int &maxInvoice ) const
 {
-    if ( !isIncluded ( name, addr ) )
+    auto posByName = findByName( name, addr );
+
+    if ( posByName == sortedByName.end() )
     {
         return false ;
     }
 
-    Company tmpByName ( name, addr, "" );
-
-    // Find position of company in vector sorted by names + addresses
-    auto posByName = lower_bound(sortedByName.begin(), sortedByName.end(), tmpByName, compareFunction );
+    maxInvoice = ledgers[posByName->ledger].maxInvoice;
+    return true;
+}
 
-    // Find position of company in vector sorted by ID's. Using the previously found company
-    auto posById = lower_bound( sortedById.begin(), sortedById.end(), *posByName, [] ( const Company & company1, const Company & company2) {
-        return company1.id < company2.id;
-    } );
+bool CVATRegister::companyMedian( string_view taxID, unsigned int &median ) const
+{
+    auto posById = findById( taxID );
 
-    // Deleting the company
-    sortedByName.erase( posByName );
-    sortedById.  erase(posById );
+    if ( posById == sortedById.end() )
+    {
+        return false ;
+    }
 
+    median = logMedian( posById->ledger );
     return true;
 }
 
-bool CVATRegister::cancelCompany( const string &taxID )
+bool CVATRegister::companyMedian( string_view name, string_view addr, unsigned int &median ) const
 {
-    if ( !isIncluded ( taxID ))
+    auto posByName = findByName( name, addr );
+
+    if ( posByName == sortedByName.end() )
     {
         return false ;
     }
 
-    Company tmpById ( "", "", taxID );
+    median = logMedian( posByName->ledger );
+    return true;
+}
 
-    // Find position of company in vector sorted by ID's.
-    auto posById = lower_bound( sortedById.begin(), sortedById.end(), tmpById, [] ( const Company & company1, const Company & company2) {
-        return company1.id < company2.id;
-    } );
+pmr::vector<CVATRegister::Company>::const_iterator CVATRegister::findById( string_view id ) const
+{
+    auto pos = lower_bound( sortedById.begin(), sortedById.end(), id, CompareById() );
 
-    // Find position of company in vector sorted by names + addresses. Using the previously found company.
-    auto posByName = lower_bound(sortedByName.begin(), sortedByName.end(), *posById, compareFunction);
+    return ( pos != sortedById.end() && pos->id == id ) ? pos : sortedById.end();
+}
 
+pmr::vector<CVATRegister::Company>::const_iterator CVATRegister::findByName( string_view name, string_view address ) const
+{
+    auto pos = lower_bound( sortedByName.begin(), sortedByName.end(), NameKey { name, address }, CompareByName() );
 
-    // Deleting the company
-    sortedById.erase(posById);
-    sortedByName.erase(posByName);
+    return ( pos != sortedByName.end() && ! CompareByName()( NameKey { name, address }, *pos ) ) ? pos : sortedByName.end();
+}
 
-    return true;
+void CVATRegister::book( Company & byId, Company & byName, unsigned int amount )
+{
+    // Increase a total income of company
+    byId.income += amount;
+    byName.income += amount;
+    recordCompany( byId.ledger, amount );
 
+    // Insert the invoice to the history of all invoices
+    recordHistory( amount );
 }
 
-bool CVATRegister::invoice( const string &taxID, unsigned int amount )
+void CVATRegister::recordDated( size_t ledger, unsigned int amount, int date )
 {
+    Ledger & history = ledgers[ledger];
+
+    // The new invoice is a run of 1, it merges with the runs of sizes 1, 2, 4 ... at the end ( carry of count + 1 ),
+    // regardless of the order of dates
+    size_t count = history.dated.size();
+    size_t size = ( count ^ ( count + 1 ) ) / 2 + 1;
 
-    if ( !isIncluded ( taxID ))
+    history.dated.push_back( Dated { date, amount } );
+    Dated * tail = history.dated.data() + count + 1 - size;
+
+    // Prefix sums of the merged runs back to amounts, then prefix sums of the new run
+    for ( size_t start = 0, run = size / 2; run; start += run, run /= 2 )
     {
-        return false ;
+        for ( size_t i = run - 1; i > 0; --i )
+        {
+            tail[start + i].value -= tail[start + i - 1].value;
+        }
+    }
+    mergeRuns( tail, size );
+    for ( size_t i = 1; i < size; ++i )
+    {
+        tail[i].value += tail[i - 1].value;
     }
 
-    Company tmpById ( "", "", taxID );
-
-    // Find position of company in vector sorted by ID's.
-    auto posById = lower_bound( sortedById.begin(), sortedById.end(), tmpById, [] ( const Company & company1, const Company & company2) {
-        return company1.id < company2.id;
-    } );
+    // Global dated history, the same carry in base MERGE_WAYS, every run merged is decoded from the wavelet matrix.
+    // A run is rebuilt once per digit, the matrix is re-encoded about log8 n times per invoice
+    size_t firstRun = runs.size();
+    size = 1;
+    while ( firstRun >= MERGE_WAYS - 1 && runs[firstRun - 1].size == size && runs[firstRun - ( MERGE_WAYS - 1 )].size == size )
+    {
+        firstRun -= MERGE_WAYS - 1;
+        size *= MERGE_WAYS;
+    }
+    size_t start = datedDates.size() + 1 - size;
 
-    // Find position of company in vector sorted by names + addresses. Using the previously found company.
-    auto posByName = lower_bound(sortedByName.begin(), sortedByName.end(), *posById, compareFunction );
+    vector<unsigned int> amounts;
+    amounts.reserve( size );
+    for ( size_t run = firstRun; run < runs.size(); ++run )
+    {
+        runAmounts( runs[run], amounts );
+    }
+    amounts.push_back( amount );
+    datedDates.push_back( date );
 
-    // Increase a total income of company
-    posById->income += amount;
-    posByName->income += amount;
+    vector<Dated> entries ( size );
+    for ( size_t i = 0; i < size; ++i )
+    {
+        entries[i] = Dated { datedDates[start + i], amounts[i] };
+    }
 
-    // Insert the invoice to the vector of all invoices
-    invoices.push_back( amount );
+    // Runs are merged from the end, the smallest first
+    size_t merged = 1;
+    for ( size_t run = runs.size(); run-- > firstRun; )
+    {
+        inplace_merge( entries.end() - merged - runs[run].size, entries.end() - merged, entries.end(), [] ( const Dated & a, const Dated & b ) {
+            return a.date < b.date;
+        } );
+        merged += runs[run].size;
+    }
 
-    return true;
+    for ( size_t i = 0; i < size; ++i )
+    {
+        datedDates[start + i] = entries[i].date;
+    }
+    runs.resize( firstRun );
+    runs.push_back( Run { start, size, {} } );
+    buildRun( entries );
 }
 
-bool CVATRegister::invoice(const string &name, const string &addr, unsigned int amount) {
+void CVATRegister::recordCompany( size_t ledger, unsigned int amount )
+{
+    Ledger & history = ledgers[ledger];
+
+    history.count++;
+    history.maxInvoice = max( history.maxInvoice, amount );
 
-    if ( !isIncluded ( name, addr ) )
+    if ( ! companyLogs )
     {
-        return false ;
+        return;
     }
 
-    Company tmpByName ( name, addr, "" );
-
-    // Find position of company in vector sorted by names + addresses
-    auto posByName = lower_bound(sortedByName.begin(), sortedByName.end(), tmpByName, compareFunction );
-
-    // Find position of company in vector sorted by ID's. Using the previously found company
-    auto posById = lower_bound( sortedById.begin(), sortedById.end(), *posByName, [] ( const Company & company1, const Company & company2) {
-        return company1.id < company2.id;
-    } );
+    // Zigzag encoded difference to the previous amount, repeated amounts take a single byte
+    unsigned int delta = amount - history.logLast;
+    unsigned int zigzag = ( delta << 1 ) ^ ( - ( delta >> 31 ) );
 
-    // Increase a total income of company
-    posByName->income += amount;
-    posById->income += amount;
+    // Varint, 7 bits per byte, the highest bit marks a continuation
+    do
+    {
+        if ( history.logBytes == history.log.size() * LOG_CHUNK )
+        {
+            history.log.emplace_back();
+        }
 
-    // Insert the invoice to the vector of all invoices
-    invoices.push_back( amount );
+        unsigned char byte = zigzag & 0x7F;
+        zigzag >>= 7;
+        history.log[history.logBytes / LOG_CHUNK][history.logBytes % LOG_CHUNK] = zigzag ? ( byte | 0x80 ) : byte;
+        history.logBytes++;
+    }
+    while ( zigzag );
 
-    return true;
+    history.logLast = amount;
+    history.logCount++;
 }
 
-bool CVATRegister::audit(const string &name, const string &addr, unsigned int &sumIncome) const
+vector<unsigned int> CVATRegister::decodeLog( size_t ledger ) const
 {
-    if (! isIncluded( name, addr ))
+    const Ledger & history = ledgers[ledger];
+
+    vector<unsigned int> amounts;
+    amounts.reserve( history.logCount );
+
+    unsigned int last = 0;
+    size_t pos = 0;
+    while ( pos < history.logBytes )
     {
-        return false ;
+        unsigned int zigzag = 0;
+        int shift = 0;
+        unsigned char byte;
+
+        do
+        {
+            byte = history.log[pos / LOG_CHUNK][pos % LOG_CHUNK];
+            zigzag |= ( byte & 0x7Fu ) << shift;
+            shift += 7;
+            pos++;
+        }
+        while ( byte & 0x80 );
+
+        last += ( zigzag >> 1 ) ^ ( - ( zigzag & 1 ) );
+        amounts.push_back( last );
     }
 
-    Company tmpByName ( name, addr, "" );
+    return amounts;
+}
 
-    // Find position of company in vector sorted by names + addresses
-    auto posByName = lower_bound(sortedByName.begin(), sortedByName.end(), tmpByName, compareFunction );
+unsigned int CVATRegister::logMedian( size_t ledger ) const
+{
+    vector<unsigned int> amounts = decodeLog( ledger );
 
-    sumIncome = posByName->income;
-    return true;
+    if ( amounts.empty() )
+    {
+        return 0;
+    }
 
+    // The greater value from the 2 values in the middle for even count
+    auto middle = amounts.begin() + amounts.size() / 2;
+    nth_element( amounts.begin(), middle, amounts.end() );
+    return *middle;
 }
 
-bool CVATRegister::audit(const string &taxID, unsigned int &sumIncome) const
+unsigned int CVATRegister::ledgerSum( size_t ledger, int from, int to ) const
 {
-    if ( !isIncluded ( taxID ))
+    const pmr::vector<Dated> & dated = ledgers[ledger].dated;
+    unsigned int sum = 0;
+
+    // Difference of prefix sums in every run
+    for ( size_t start = 0, size; start < dated.size(); start += size )
     {
-        return false ;
-    }
+        size = runSize( dated.size() - start );
+        auto first = dated.begin() + start;
+        size_t lo = lower_bound( first, first + size, from, [] ( const Dated & entry, int date ) { return entry.date < date; } ) - first;
+        size_t hi = upper_bound( first, first + size, to,   [] ( int date, const Dated & entry ) { return date < entry.date; } ) - first;
 
-    Company tmpById ( "", "", taxID );
+        if ( hi > lo )
+        {
+            sum += first[hi - 1].value - ( lo ? first[lo - 1].value : 0 );
+        }
+    }
 
-    // Find position of company in vector sorted by ID's
-    auto posById = lower_bound( sortedById.begin(), sortedById.end(), tmpById, [] ( const Company & company1, const Company & company2) {
-        return company1.id < company2.id;
-    } );
+    return sum;
+}
 
-    sumIncome = posById->income;
-    return true;
+size_t CVATRegister::runSize( size_t remaining )
+{
+    size_t size = 1;
+    while ( size <= remaining / 2 )
+    {
+        size *= 2;
+    }
+    return size;
 }
 
-bool CVATRegister::firstCompany(string &name, string &addr) const
+void CVATRegister::mergeRuns( Dated * tail, size_t size )
 {
-    // Check if there are any companies
-    if ( sortedByName.empty())
+    // The new entry with the run of 1 before it, the result with the run of 2 before it, ...
+    for ( size_t merged = 1; merged < size; merged *= 2 )
     {
-        return false;
+        inplace_merge( tail + size - 2 * merged, tail + size - merged, tail + size, [] ( const Dated & a, const Dated & b ) {
+            return a.date < b.date;
+        } );
     }
+}
 
-    // Return first of them in vector sorted by names + addresses
-    name = sortedByName[0].name;
-    addr = sortedByName[0].address;
-    return true;
+size_t CVATRegister::onesBefore( int level, size_t pos ) const
+{
+    const LevelWord & word = levels[level][pos / 64];
+    return word.ones + bitset<64>( word.bits & ( ( (uint64_t) 1 << ( pos % 64 ) ) - 1 ) ).count();
 }
 
-bool CVATRegister::nextCompany(string &name, string &addr) const
+void CVATRegister::runAmounts( const Run & run, vector<unsigned int> & amounts ) const
 {
-    // Check if there are any companies
-    if ( sortedByName.empty())
+    // The partitions of the levels are repeated, every amount carries its index in the run to its final position
+    vector<pair<unsigned int, size_t>> order ( run.size ), next ( run.size );
+    for ( size_t i = 0; i < run.size; ++i )
     {
-        return false;
+        order[i] = { 0, i };
     }
 
-    Company tmpCompany ( name, addr, "" );
+    for ( int level = 0; level < LEVELS; ++level )
+    {
+        const pmr::vector<LevelWord> & words = levels[level];
+        size_t slots[2] = { 0, run.zeros[level] };
+        for ( size_t i = 0, pos = run.start; i < run.size; ++i, ++pos )
+        {
+            unsigned int bit = ( words[pos / 64].bits >> ( pos % 64 ) ) & 1;
+            order[i].first |= bit << ( LEVELS - 1 - level );
+            next[slots[bit]++] = order[i];
+        }
+        order.swap( next );
+    }
 
-    // Find the first company, after the company with given name and address
-    auto pos = upper_bound(sortedByName.begin(), sortedByName.end(), tmpCompany, compareFunction );
+    size_t first = amounts.size();
+    amounts.resize( first + run.size );
+    for ( const auto & [ amount, index ] : order )
+    {
+        amounts[first + index] = amount;
+    }
+}
 
-    // No company found
-    if ( pos == sortedByName.end() )
+void CVATRegister::buildRun( const vector<Dated> & entries )
+{
+    size_t start = runs.back().start, end = start + entries.size();
+
+    vector<unsigned int> order, next ( entries.size() );
+    order.reserve( entries.size() );
+    for ( const Dated & entry : entries )
     {
-        return false;
+        order.push_back( entry.value );
     }
 
-    name = pos->name;
-    addr = pos->address;
-    return true;
+    // Every level is stably partitioned by its bit, zeros first
+    for ( int level = 0; level < LEVELS; ++level )
+    {
+        pmr::vector<LevelWord> & words = levels[level];
+        int shift = LEVELS - 1 - level;
+
+        // One word more than needed, so that onesBefore works up to the end, the bits of the run are rewritten
+        // a word at a time, the bits before the run are kept
+        words.resize( end / 64 + 1 );
+        uint64_t bits = words[start / 64].bits & ( ( (uint64_t) 1 << ( start % 64 ) ) - 1 );
+        size_t zeros = 0;
+        for ( size_t i = 0, pos = start; i < order.size(); ++i, ++pos )
+        {
+            uint64_t bit = ( order[i] >> shift ) & 1;
+            bits |= bit << ( pos % 64 );
+            zeros += ! bit;
+            if ( pos % 64 == 63 )
+            {
+                words[pos / 64].bits = bits;
+                bits = 0;
+            }
+        }
+        words[end / 64].bits = bits;
+        runs.back().zeros[level] = zeros;
+
+        // Without branches, the bits are random
+        size_t slots[2] = { 0, zeros };
+        for ( unsigned int amount : order )
+        {
+            next[slots[( amount >> shift ) & 1]++] = amount;
+        }
+        order.swap( next );
+
+        // Counts of ones of the words after the start of the run
+        for ( size_t word = start / 64 + 1; word <= end / 64; ++word )
+        {
+            words[word].ones = words[word - 1].ones + bitset<64>( words[word - 1].bits ).count();
+        }
+    }
 }
 
-unsigned int CVATRegister::medianInvoice(void) const
+int CVATRegister::compareNoCase( string_view text1, string_view text2 )
 {
-    // Default return value is 0
-    if ( invoices.empty() )
+    // Same order as comparing both strings converted to lowercase
+    size_t length = min( text1.size(), text2.size() );
+    for ( size_t i = 0; i < length; ++i )
     {
-        return 0;
+        int c1 = ::tolower( (unsigned char) text1[i] );
+        int c2 = ::tolower( (unsigned char) text2[i] );
+        if ( c1 != c2 )
+        {
+            return (unsigned char) c1 < (unsigned char) c2 ? -1 : 1;
+        }
     }
 
-    // Sort all of the invoices
-    vector<unsigned int> tmpInvoices = invoices;
-    sort (tmpInvoices.begin(), tmpInvoices.end());
+    return text1.size() == text2.size() ? 0 : ( text1.size() < text2.size() ? -1 : 1 );
+}
 
-    // If the number of invoices is odd, return the middle one
-    if ( invoices.size() % 2 )
+bool CVATRegister::isIncluded( string_view id ) const
+{
+    return binary_search( sortedById.begin(), sortedById.end(), id, CompareById() );
+}
+
+bool CVATRegister::isIncluded( string_view name, string_view address ) const
+{
+    return binary_search( sortedByName.begin(), sortedByName.end(), NameKey { name, address }, CompareByName() );
+}
+
+
+CVATRegister::CVATRegister(void)
+    : CVATRegister( pmr::get_default_resource() )
+{
+}
+
+CVATRegister::CVATRegister( pmr::memory_resource * resource, bool abandonOnDestroy )
+    : sortedById ( resource ), sortedByName ( resource ), invoices ( resource ),
+      distinctAmounts ( resource ), amountCounts ( resource ), rankTree ( resource ), pendingAmounts ( resource ),
+      ledgers ( resource ), freeLedgers ( resource ), resource ( resource ), abandonOnDestroy ( abandonOnDestroy ),
+      datedDates ( resource ), levels ( LEVELS, resource ), runs ( resource )
+{
+}
+
+CVATRegister::~CVATRegister(void)
+{
+    // The resource ignores deallocation, so the companies and ledgers are not destroyed one by one,
+    // they are moved to the resource as they are and released together with it
+    if ( abandonOnDestroy )
     {
-        return tmpInvoices[floor(invoices.size()/2)];
+        abandon( sortedById );
+        abandon( sortedByName );
+        abandon( ledgers );
     }
+}
 
-    // Else return the greater value from the 2 values in the middle ( Vector is sorted in ascending order -> the greater index )
-    else
+template <typename Container>
+void CVATRegister::abandon( Container & container )
+{
+    try
     {
-        return tmpInvoices[(invoices.size()/2)];
+        void * block = resource->allocate( sizeof( Container ), alignof( Container ) );
+        // The move takes over the buffer of the container ( same allocator ), so no element is touched
+        new ( block ) Container( std::move( container ) );
+    }
+    catch ( const bad_alloc & )
+    {
+        // The arena is exhausted, the container is destroyed the usual way
     }
 }
 
-void CVATRegister::toLowerCase( string & text )
+
+
+
+
+#ifndef __PROGTEST__
+/**
+ * @brief Number of heap allocations so far, used to check that lookups don't allocate
+ */
+static size_t     allocations    = 0;
+
+void *            operator new   ( size_t size )
 {
-    for_each( text.begin(), text.end(), []( char & c )
+    allocations++;
+    if ( void * ptr = malloc ( size ? size : 1 ) )
     {
-        c = ::tolower(c);
-    } );
+        return ptr;
+    }
+    throw bad_alloc ();
 }
 
-bool CVATRegister::compareFunction(CVATRegister::Company company1, CVATRegister::Company company2)
+void *            operator new   ( size_t size, const nothrow_t & ) noexcept
 {
-    // We want to compare case-insensitive
-    toLowerCase( company1.name );
-    toLowerCase( company2.name );
-    toLowerCase( company1.address );
-    toLowerCase( company2.address );
+    allocations++;
+    return malloc ( size ? size : 1 );
+}
 
-    return company1.name != company2.name ? company1.name < company2.name : company1.address < company2.address;
+void              operator delete ( void * ptr ) noexcept
+{
+    free ( ptr );
 }
 
-bool CVATRegister::isIncluded(const string &id) const
+void              operator delete ( void * ptr, size_t ) noexcept
 {
-    Company toSearch ( "", "", id );
+    free ( ptr );
+}
 
-    return binary_search(sortedById.begin(), sortedById.end(), toSearch, [] ( Company company1, Company company2 ) {
-        return ( company1.id < company2.id ) ;
-    } );
+#ifdef BENCHMARK
+/**
+ * @brief Runs construct / populate / destroy cycles of a register
+ * @param resource Memory resource of the register
+ * @param abandonOnDestroy Passed to the constructor of the register
+ * @param release Called after every cycle ( e.g. to release an arena )
+ * @param populateTime Time spent by construction and population
+ * @param destroyTime Time spent by destruction of the register
+ * @param releaseTime Time spent by the release
+ */
+template <typename Release>
+static void       cycles         ( pmr::memory_resource * resource, bool abandonOnDestroy, Release release, chrono::nanoseconds & populateTime,
+                                   chrono::nanoseconds & destroyTime, chrono::nanoseconds & releaseTime )
+{
+    for ( int cycle = 0; cycle < 10; ++cycle )
+    {
+        auto start = chrono::steady_clock::now();
+        auto reg = make_unique<CVATRegister> ( resource, abandonOnDestroy );
+        for ( int i = 0; i < 2000; ++i )
+        {
+            reg -> newCompany ( "Company number " + to_string ( i ), "Long street name " + to_string ( i % 37 ), "CZ-TAX-ID-" + to_string ( i ) );
+        }
+        for ( int i = 0; i < 20000; ++i )
+        {
+            reg -> invoice ( "CZ-TAX-ID-" + to_string ( i % 2000 ), 100 + i % 1000, i / 50 );
+        }
+        auto middle = chrono::steady_clock::now();
+        reg . reset ();
+        auto destroyed = chrono::steady_clock::now();
+        release ();
+        auto end = chrono::steady_clock::now();
+
+        populateTime += middle - start;
+        destroyTime  += destroyed - middle;
+        releaseTime  += end - destroyed;
+    }
 }
 
-bool CVATRegister::isIncluded(const string &name, const string &address) const
+/**
+ * @brief Compares construct / populate / destroy cycles on the default heap and on a monotonic arena
+ */
+static void       benchmarkArena ( void )
 {
-    Company toSearch ( name, address, "" );
-    return binary_search(sortedByName.begin(), sortedByName.end(), toSearch, compareFunction );
+    chrono::nanoseconds heapPopulate { 0 }, heapDestroy { 0 }, heapRelease { 0 }, arenaPopulate { 0 }, arenaDestroy { 0 }, arenaRelease { 0 };
+    // One preallocated arena serves all cycles, its release only rewinds it to the start of the buffer
+    vector<char> buffer ( 16 << 20 );
+    pmr::monotonic_buffer_resource arena ( buffer . data (), buffer . size (), pmr::null_memory_resource () );
+
+    cycles ( pmr::new_delete_resource (), false, [] () {}, heapPopulate, heapDestroy, heapRelease );
+    cycles ( & arena, true, [ & arena ] () { arena . release (); }, arenaPopulate, arenaDestroy, arenaRelease );
+
+    cout << "heap:  populate " << chrono::duration_cast<chrono::microseconds> ( heapPopulate ) . count () << " us, "
+         << "destroy " << chrono::duration_cast<chrono::microseconds> ( heapDestroy ) . count () << " us" << endl;
+    cout << "arena: populate " << chrono::duration_cast<chrono::microseconds> ( arenaPopulate ) . count () << " us, "
+         << "destroy " << chrono::duration_cast<chrono::microseconds> ( arenaDestroy ) . count () << " us, "
+         << "release " << chrono::duration_cast<chrono::microseconds> ( arenaRelease ) . count () << " us" << endl;
 }
 
+/**
+ * @brief Compares the plain and the run-length history on invoices clustered on round amounts
+ */
+static void       benchmarkRunLength ( void )
+{
+    const unsigned int count = 1000000;
+    vector<unsigned int> amounts;
+    unsigned int seed = 12345;
+
+    // 95 % of invoices are multiples of 500 up to 50000, the rest are arbitrary amounts
+    for ( unsigned int i = 0; i < count; ++i )
+    {
+        seed = seed * 1103515245 + 12345;
+        unsigned int random = seed >> 8;
+        amounts . push_back ( random % 100 < 95 ? 500 * ( 1 + random % 100 ) : random % 100000 );
+    }
 
-CVATRegister::CVATRegister(void) = default;
+    vector<unsigned int> distinct = amounts;
+    sort ( distinct . begin (), distinct . end () );
+    distinct . erase ( unique ( distinct . begin (), distinct . end () ), distinct . end () );
 
-CVATRegister::~CVATRegister(void) = default;
+    for ( bool runLength : { false, true } )
+    {
+        CVATRegister reg;
+        reg . setRunLengthHistory ( runLength );
+        reg . newCompany ( "ACME", "Kolejni", "abcdef" );
 
+        auto start = chrono::steady_clock::now();
+        for ( unsigned int amount : amounts )
+        {
+            reg . invoice ( "abcdef", amount );
+        }
+        auto middle = chrono::steady_clock::now();
+        unsigned int median = 0;
+        for ( int i = 0; i < 10; ++i )
+        {
+            median += reg . medianInvoice ();
+        }
+        auto end = chrono::steady_clock::now();
 
+        cout << ( runLength ? "run-length" : "plain     " ) << " history: invoice "
+             << chrono::duration_cast<chrono::milliseconds> ( middle - start ) . count () << " ms, 10x median "
+             << chrono::duration_cast<chrono::microseconds> ( end - middle ) . count () << " us ( " << median / 10 << " )" << endl;
+    }
 
+    // Arbitrary amounts are almost all new, every one of them passes through the pending buffer
+    CVATRegister spread;
+    spread . setRunLengthHistory ( true );
+    spread . newCompany ( "ACME", "Kolejni", "abcdef" );
+    auto start = chrono::steady_clock::now();
+    for ( unsigned int i = 0; i < count; ++i )
+    {
+        seed = seed * 1103515245 + 12345;
+        spread . invoice ( "abcdef", seed );
+    }
+    auto end = chrono::steady_clock::now();
+    cout << "run-length history, arbitrary amounts: invoice "
+         << chrono::duration_cast<chrono::milliseconds> ( end - start ) . count () << " ms ( " << spread . medianInvoice () << " )" << endl;
 
+    // Plain history keeps 4 B per invoice, run-length one 12 B per distinct amount ( amount, count, Fenwick node )
+    cout << "distinct amounts " << distinct . size () << " of " << count << ", compression ratio "
+         << ( 4.0 * count ) / ( 12.0 * distinct . size () ) << endl;
+}
+#endif /* BENCHMARK */
 
-#ifndef __PROGTEST__
 int               main           ( void )
 {
     string name, addr;
@@ -542,6 +1887,203 @@ int               main           ( void )
     assert ( b2 . cancelCompany ( "ACME", "Kolejni" ) );
     assert ( ! b2 . cancelCompany ( "ACME", "Kolejni" ) );
 
+    CVATRegister b3;
+    assert ( b3 . newCompany ( "ACME", "Kolejni", "abcdef" ) );
+    assert ( b3 . newCompany ( "Dummy", "Kolejni", "123456" ) );
+    assert ( b3 . medianInvoice ( 0, 100 ) == 0 );
+    assert ( b3 . invoice ( "abcdef", 1000, 10 ) );
+    assert ( b3 . invoice ( "abcdef", 2000, 20 ) );
+    assert ( b3 . invoice ( "Dummy", "Kolejni", 500, 20 ) );
+    assert ( b3 . invoice ( "abcdef", 4000, 30 ) );
+    assert ( ! b3 . invoice ( "1234", 100, 30 ) );
+    assert ( b3 . audit ( "abcdef", 10, 20, sumIncome ) && sumIncome == 3000 );
+    assert ( b3 . audit ( "abcdef", 11, 30, sumIncome ) && sumIncome == 6000 );
+    assert ( b3 . audit ( "ACME", "kolejni", 31, 40, sumIncome ) && sumIncome == 0 );
+    assert ( b3 . audit ( "abcdef", sumIncome ) && sumIncome == 7000 );
+    assert ( ! b3 . audit ( "1234", 0, 100, sumIncome ) );
+    assert ( b3 . medianInvoice ( 0, 100 ) == 2000 );
+    assert ( b3 . medianInvoice ( 20, 20 ) == 2000 );
+    assert ( b3 . medianInvoice ( 21, 29 ) == 0 );
+    assert ( b3 . medianInvoice () == 2000 );
+    assert ( b3 . invoice ( "abcdef", 3000, 15 ) );
+    assert ( b3 . audit ( "abcdef", 10, 20, sumIncome ) && sumIncome == 6000 );
+    assert ( b3 . audit ( "abcdef", 16, 30, sumIncome ) && sumIncome == 6000 );
+    assert ( b3 . medianInvoice ( 10, 15 ) == 3000 );
+    assert ( b3 . medianInvoice ( 0, 100 ) == 2000 );
+    assert ( b3 . invoice ( "123456", 5000, 40 ) );
+    assert ( b3 . medianInvoice ( 0, 100 ) == 3000 );
+    assert ( b3 . cancelCompany ( "abcdef" ) );
+    assert ( b3 . medianInvoice ( 10, 30 ) == 2000 );
+    assert ( b3 . newCompany ( "ACME", "Thakurova", "abcdef" ) );
+    assert ( b3 . audit ( "abcdef", 0, 100, sumIncome ) && sumIncome == 0 );
+    assert ( b3 . medianInvoice ( 30, 10 ) == 0 );
+
+    // Invoices in random order of dates against a plain list of them
+    CVATRegister b9;
+    vector<pair<int, unsigned int>> dated[2];
+    assert ( b9 . newCompany ( "ACME", "Kolejni", "abcdef" ) );
+    assert ( b9 . newCompany ( "Dummy", "Kolejni", "123456" ) );
+    unsigned int seed = 1;
+    for ( int i = 1; i <= 3000; ++i )
+    {
+        seed = seed * 1103515245 + 12345;
+        int company = ( seed >> 16 ) % 2, date = ( seed >> 8 ) % 1000;
+        unsigned int amount = i % 7 ? ( seed >> 4 ) % 5000 : 4000000000u + i;
+        assert ( company ? b9 . invoice ( "Dummy", "Kolejni", amount, date ) : b9 . invoice ( "abcdef", amount, date ) );
+        dated[company] . emplace_back ( date, amount );
+
+        if ( i % 97 == 0 || i == 1024 || i == 2047 )
+        {
+            int from = ( seed >> 3 ) % 1000, to = from + ( seed >> 12 ) % 400;
+            vector<unsigned int> period;
+            unsigned int sums[2] = { 0, 0 };
+            for ( int c = 0; c < 2; ++c )
+            {
+                for ( auto [ invoiceDate, invoiceAmount ] : dated[c] )
+                {
+                    if ( invoiceDate >= from && invoiceDate <= to )
+                    {
+                        period . push_back ( invoiceAmount );
+                        sums[c] += invoiceAmount;
+                    }
+                }
+            }
+            sort ( period . begin (), period . end () );
+            assert ( b9 . medianInvoice ( from, to ) == ( period . empty () ? 0 : period[period . size () / 2] ) );
+            assert ( b9 . audit ( "abcdef", from, to, sumIncome ) && sumIncome == sums[0] );
+            assert ( b9 . audit ( "Dummy", "Kolejni", from, to, sumIncome ) && sumIncome == sums[1] );
+        }
+    }
+
+    static char buffer[1 << 16];
+    pmr::monotonic_buffer_resource arena ( buffer, sizeof ( buffer ), pmr::null_memory_resource () );
+    // Nothing may be drawn from the default resource either
+    pmr::memory_resource * defaultResource = pmr::set_default_resource ( pmr::null_memory_resource () );
+    {
+        CVATRegister b4 ( & arena, true );
+        assert ( b4 . newCompany ( "ACME with a name longer than small string buffer", "Kolejni", "abcdef" ) );
+        assert ( b4 . newCompany ( "Dummy", "Thakurova with an address longer than small string buffer", "123456" ) );
+        assert ( b4 . invoice ( "abcdef", 1000, 10 ) );
+        assert ( b4 . invoice ( "Dummy", "Thakurova with an address longer than small string buffer", 3000, 12 ) );
+        assert ( b4 . cancelCompany ( "abcdef" ) );
+        assert ( b4 . newCompany ( "ACME", "Kolejni", "abcdef" ) );
+        assert ( b4 . invoice ( "abcdef", 2000, 11 ) );
+        assert ( b4 . audit ( "123456", 0, 20, sumIncome ) && sumIncome == 3000 );
+        assert ( b4 . medianInvoice ( 10, 11 ) == 2000 );
+        assert ( b4 . firstCompany ( name, addr ) && name == "ACME" && addr == "Kolejni" );
+    }
+    pmr::set_default_resource ( defaultResource );
+
+    CVATRegister b5;
+    unsigned int count, maxInvoice, median;
+    assert ( b5 . newCompany ( "ACME", "Kolejni", "abcdef" ) );
+    assert ( b5 . newCompany ( "Dummy", "Kolejni", "123456" ) );
+    assert ( b5 . invoice ( "abcdef", 500 ) );
+    b5 . setCompanyLogs ( true );
+    assert ( b5 . companyCount ( "abcdef", count ) && count == 1 );
+    assert ( b5 . companyMedian ( "abcdef", median ) && median == 0 );
+    assert ( b5 . invoice ( "abcdef", 4000000000u ) );
+    assert ( b5 . invoice ( "abcdef", 1000 ) );
+    assert ( b5 . invoice ( "ACME", "Kolejni", 1000, 5 ) );
+    assert ( b5 . invoice ( "abcdef", 3 ) );
+    assert ( b5 . invoice ( "123456", 7 ) );
+    assert ( b5 . companyCount ( "ACME", "kolejni", count ) && count == 5 );
+    assert ( b5 . companyMax ( "abcdef", maxInvoice ) && maxInvoice == 4000000000u );
+    assert ( b5 . companyMedian ( "abcdef", median ) && median == 1000 );
+    assert ( b5 . invoice ( "abcdef", 4000000000u ) );
+    assert ( b5 . invoice ( "abcdef", 4000000000u ) );
+    assert ( b5 . companyMedian ( "ACME", "Kolejni", median ) && median == 4000000000u );
+    assert ( b5 . companyMedian ( "123456", median ) && median == 7 );
+    assert ( b5 . companyMax ( "Dummy", "Kolejni", maxInvoice ) && maxInvoice == 7 );
+    assert ( ! b5 . companyCount ( "1234", count ) );
+    assert ( ! b5 . companyMedian ( "ACME", "Thakurova", median ) );
+    assert ( b5 . cancelCompany ( "abcdef" ) );
+    assert ( b5 . newCompany ( "ACME", "Kolejni", "abcdef" ) );
+    assert ( b5 . companyCount ( "abcdef", count ) && count == 0 );
+    assert ( b5 . companyMax ( "abcdef", maxInvoice ) && maxInvoice == 0 );
+    assert ( b5 . companyMedian ( "abcdef", median ) && median == 0 );
+    for ( unsigned int i = 0; i < 1000; ++i )
+    {
+        assert ( b5 . invoice ( "abcdef", i * 7919 % 1000 ) );
+    }
+    assert ( b5 . companyMedian ( "abcdef", median ) && median == 500 );
+
+    CVATRegister b6;
+    assert ( b6 . newCompany ( "ACME", "Kolejni", "abcdef" ) );
+    assert ( b6 . invoice ( "abcdef", 2000 ) );
+    assert ( b6 . invoice ( "abcdef", 100 ) );
+    assert ( b6 . invoice ( "abcdef", 2000 ) );
+    b6 . setRunLengthHistory ( true );
+    assert ( b6 . medianInvoice () == 2000 );
+    assert ( b6 . invoice ( "abcdef", 100 ) );
+    assert ( b6 . medianInvoice () == 2000 );
+    assert ( b6 . invoice ( "abcdef", 50 ) );
+    assert ( b6 . medianInvoice () == 100 );
+    assert ( b6 . invoice ( "ACME", "Kolejni", 5000, 3 ) );
+    assert ( b6 . invoice ( "abcdef", 5000 ) );
+    assert ( b6 . medianInvoice () == 2000 );
+    assert ( b6 . audit ( "abcdef", sumIncome ) && sumIncome == 14250 );
+    b6 . setRunLengthHistory ( false );
+    assert ( b6 . medianInvoice () == 2000 );
+    assert ( b6 . invoice ( "abcdef", 1 ) );
+    assert ( b6 . invoice ( "abcdef", 1 ) );
+    assert ( b6 . medianInvoice () == 100 );
+    CVATRegister b7;
+    b7 . setRunLengthHistory ( true );
+    assert ( b7 . medianInvoice () == 0 );
+    assert ( b7 . newCompany ( "ACME", "Kolejni", "abcdef" ) );
+    vector<unsigned int> b7Amounts;
+    unsigned int b7Seed = 7;
+    for ( int i = 0; i < 2000; ++i )
+    {
+        // New amounts in random order go through the pending buffer, known ones straight to the counts
+        b7Seed = b7Seed * 1103515245 + 12345;
+        unsigned int amount = ( b7Seed >> 8 ) % 100000 + ( i % 7 ? 0 : 4000000000u );
+        if ( i % 3 == 1 )
+        {
+            amount = b7Amounts[( b7Seed >> 8 ) % b7Amounts . size ()];
+        }
+        b7Amounts . push_back ( amount );
+        assert ( b7 . invoice ( "abcdef", amount ) );
+        vector<unsigned int> sorted = b7Amounts;
+        nth_element ( sorted . begin (), sorted . begin () + sorted . size () / 2, sorted . end () );
+        assert ( b7 . medianInvoice () == sorted[sorted . size () / 2] );
+        if ( i == 1000 )
+        {
+            b7 . setRunLengthHistory ( false );
+            assert ( b7 . medianInvoice () == sorted[sorted . size () / 2] );
+            b7 . setRunLengthHistory ( true );
+        }
+    }
+
+    CVATRegister b8;
+    const string longName = "ACME Corporation with a name longer than small string buffer";
+    const string longAddr = "Thakurova 9, 160 00 Praha 6 - Dejvice, Czech Republic";
+    const char record[] = "CZ12345678901234567890-AND-SOME-PADDING";
+    assert ( b8 . newCompany ( longName, longAddr, string_view ( record, 22 ) ) );
+    assert ( b8 . newCompany ( "Dummy", longAddr, "CZ00000000000000000000" ) );
+    b8 . setRunLengthHistory ( true );
+    assert ( b8 . invoice ( "CZ00000000000000000000", 1000 ) );
+    size_t allocationsBefore = allocations;
+    for ( int i = 0; i < 100; ++i )
+    {
+        assert ( b8 . invoice ( string_view ( record, 22 ), 1000 ) );
+        assert ( b8 . invoice ( "acme corporation with a name longer than small string buffer", longAddr, 1000 ) );
+        assert ( b8 . audit ( "CZ12345678901234567890", sumIncome ) );
+        assert ( b8 . audit ( longName, "THAKUROVA 9, 160 00 PRAHA 6 - DEJVICE, CZECH REPUBLIC", sumIncome ) );
+        assert ( ! b8 . audit ( string_view ( record, 21 ), sumIncome ) );
+        assert ( ! b8 . invoice ( longName, "Kolejni", 1000 ) );
+        assert ( ! b8 . newCompany ( "Dummy", longAddr, "CZ99999999999999999999" ) );
+        assert ( ! b8 . cancelCompany ( "CZ99999999999999999999" ) );
+    }
+    assert ( allocations == allocationsBefore );
+    assert ( b8 . audit ( string_view ( record, 22 ), sumIncome ) && sumIncome == 200000 );
+
+#ifdef BENCHMARK
+    benchmarkArena ();
+    benchmarkRunLength ();
+#endif /* BENCHMARK */
+
     return EXIT_SUCCESS;
 }
 #endif /* __PROGTEST__ */
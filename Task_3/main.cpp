@@ -8,9 +8,30 @@
 #include <string>
 #include <sstream>
 #include <stdexcept>
+#include <chrono>
 using namespace std;
 #endif /* __PROGTEST__ */
 
+// Not among the headers provided by ProgTest
+#include <cstdint>
+#include <climits>
+#include <cstring>
+#include <locale>
+#include <vector>
+#include <span>
+#include <string_view>
+#include <charconv>
+#include <system_error>
+#include <algorithm>
+#include <compare>
+#include <thread>
+#include <iterator>
+#include <ranges>
+#include <bit>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif /* __AVX2__ */
+
 //=================================================================================================
 // a dummy exception class, keep this implementation
 class InvalidDateException : public invalid_argument
@@ -22,11 +43,303 @@ public:
     }
 };
 //=================================================================================================
-// date_format manipulator - a dummy implementation. Keep this code unless you implement your
-// own working manipulator.
-ios_base & ( * date_format ( const char * fmt ) ) ( ios_base & x )
+class CDate;
+
+/**
+ * @brief Manipulator setting the format of dates for a stream ( %Y, %m, %d, %% and literal characters ).
+ *        The format is compiled once to a small program, the stream keeps its own copy of the program in pword.
+ */
+class date_format
+{
+public:
+
+    /**
+     * @brief Constructor, compiles the format
+     * @param fmt Format of dates, e.g. "%d.%m.%Y"
+     */
+    explicit date_format ( const char * fmt );
+
+    /**
+     * @brief Sets the format for output of dates, sets failbit if the format is malformed ( unknown or incomplete % sequence )
+     * @param os Output stream
+     * @param format Format to be set
+     * @return Reference to the output stream
+     */
+    friend ostream & operator << ( ostream & os, const date_format & format );
+
+    /**
+     * @brief Sets the format for input of dates, sets failbit if the format is malformed or it doesn't contain each of %Y, %m, %d once
+     * @param iss Input stream
+     * @param format Format to be set
+     * @return Reference to the input stream
+     */
+    friend istream & operator >> ( istream & iss, const date_format & format );
+
+    friend ostream & operator << ( ostream & os, CDate self );
+    friend istream & operator >> ( istream & iss, CDate & self );
+
+private:
+
+    /**
+     * @brief Instructions of the compiled format
+     */
+    enum EOp : char { LITERAL, YEAR, MONTH, DAY };
+
+    /**
+     * @brief One instruction, the character is used by LITERAL only
+     */
+    struct Op {
+        EOp code;
+        char literal;
+    };
+
+    vector<Op> program;
+
+    /**
+     * @brief False if the format contained an unknown or incomplete % sequence
+     */
+    bool valid = true;
+
+    /**
+     * @brief True if the format contains each of %Y, %m, %d exactly once, so it can be used for input
+     */
+    bool readable = false;
+
+    /**
+     * @brief True if the format is %Y-%m-%d, the stream then uses the default ISO path
+     */
+    bool iso = false;
+
+    /**
+     * @brief Index of the program in pword / of the callback flag in iword of all streams
+     * @return Index allocated by xalloc
+     */
+    static int index ( void );
+
+    /**
+     * @brief Stream callback, copies the program on copyfmt and deletes it on erase ( destruction, before copyfmt )
+     * @param event Stream event
+     * @param ios Stream
+     * @param idx Index of the program
+     */
+    static void callback ( ios_base::event event, ios_base & ios, int idx );
+
+    /**
+     * @brief Stores a copy of the format to the stream
+     * @param ios Stream
+     */
+    void apply ( ios_base & ios ) const;
+
+    /**
+     * @brief Finds the format of the stream
+     * @param ios Stream
+     * @return Format set by the manipulator, nullptr for the default ISO format
+     */
+    static const date_format * current ( ios_base & ios );
+
+    /**
+     * @brief Runs the program for output
+     * @param os Output stream
+     * @param year Year of the date
+     * @param month Month of the date
+     * @param day Day of the date
+     */
+    void write ( ostream & os, int year, int month, int day ) const;
+
+    /**
+     * @brief Runs the program for input, the date is not validated
+     * @param iss Input stream ( its leading whitespace is already skipped )
+     * @param year Year of the date
+     * @param month Month of the date
+     * @param day Day of the date
+     * @return True if the input matched the format
+     */
+    bool read ( istream & iss, int & year, int & month, int & day ) const;
+};
+
+date_format::date_format( const char * fmt )
+{
+    int fields[3] = { 0, 0, 0 };
+
+    for ( ; * fmt; ++fmt )
+    {
+        if ( * fmt != '%' )
+        {
+            program.push_back( { LITERAL, * fmt } );
+            continue;
+        }
+
+        switch ( * ++fmt )
+        {
+            case 'Y': program.push_back( { YEAR,  0 } ); fields[0]++; break;
+            case 'm': program.push_back( { MONTH, 0 } ); fields[1]++; break;
+            case 'd': program.push_back( { DAY,   0 } ); fields[2]++; break;
+            case '%': program.push_back( { LITERAL, '%' } ); break;
+            default:
+                valid = false;
+                return;
+        }
+    }
+
+    readable = fields[0] == 1 && fields[1] == 1 && fields[2] == 1;
+    iso = program.size() == 5 && program[0].code == YEAR
+                              && program[1].code == LITERAL && program[1].literal == '-'
+                              && program[2].code == MONTH
+                              && program[3].code == LITERAL && program[3].literal == '-'
+                              && program[4].code == DAY;
+}
+
+ostream & operator << ( ostream & os, const date_format & format )
+{
+    if ( ! format.valid )
+    {
+        os.setstate( ios::failbit );
+        return os;
+    }
+
+    format.apply( os );
+    return os;
+}
+
+istream & operator >> ( istream & iss, const date_format & format )
+{
+    if ( ! format.valid || ! format.readable )
+    {
+        iss.setstate( ios::failbit );
+        return iss;
+    }
+
+    format.apply( iss );
+    return iss;
+}
+
+int date_format::index( void )
+{
+    static const int idx = ios_base::xalloc();
+    return idx;
+}
+
+void date_format::callback( ios_base::event event, ios_base & ios, int idx )
+{
+    void * & slot = ios.pword( idx );
+
+    if ( event == ios_base::erase_event )
+    {
+        delete static_cast<date_format *>( slot );
+        slot = nullptr;
+    }
+    else if ( event == ios_base::copyfmt_event && slot )
+    {
+        // copyfmt copied just the pointer, the stream needs its own program
+        slot = new date_format( * static_cast<date_format *>( slot ) );
+    }
+}
+
+void date_format::apply( ios_base & ios ) const
+{
+    int idx = index();
+
+    if ( ! ios.iword( idx ) )
+    {
+        ios.register_callback( callback, idx );
+        ios.iword( idx ) = 1;
+    }
+
+    void * & slot = ios.pword( idx );
+    delete static_cast<date_format *>( slot );
+    slot = iso ? nullptr : new date_format( * this );
+}
+
+const date_format * date_format::current( ios_base & ios )
+{
+    return static_cast<const date_format *>( ios.pword( index() ) );
+}
+
+void date_format::write( ostream & os, int year, int month, int day ) const
+{
+    char buffer[64];
+    size_t length = 0;
+
+    for ( const Op & op : program )
+    {
+        // Flush before the buffer could overflow ( a year takes at most 11 characters )
+        if ( length > sizeof ( buffer ) - 12 )
+        {
+            os.write( buffer, length );
+            length = 0;
+        }
+
+        switch ( op.code )
+        {
+            case LITERAL:
+                buffer[length++] = op.literal;
+                break;
+            case YEAR:
+                length = to_chars( buffer + length, buffer + sizeof ( buffer ), year ).ptr - buffer;
+                break;
+            case MONTH:
+            case DAY:
+            {
+                int value = op.code == MONTH ? month : day;
+                buffer[length++] = (char) ( '0' + value / 10 );
+                buffer[length++] = (char) ( '0' + value % 10 );
+                break;
+            }
+        }
+    }
+
+    os.write( buffer, length );
+}
+
+bool date_format::read( istream & iss, int & year, int & month, int & day ) const
 {
-    return [] ( ios_base & ios ) -> ios_base & { return ios; };
+    streambuf * source = iss.rdbuf();
+    const int eof = char_traits<char>::eof();
+
+    for ( const Op & op : program )
+    {
+        int c = source->sgetc();
+
+        // Input ending inside the date sets eofbit as well, as extraction of a truncated number does
+        if ( op.code == LITERAL )
+        {
+            if ( c != (unsigned char) op.literal )
+            {
+                if ( c == eof )
+                {
+                    iss.setstate( ios::eofbit );
+                }
+                return false;
+            }
+            source->snextc();
+            continue;
+        }
+
+        // Fields take at most 4 ( year ) or 2 digits, so that formats without separators work too
+        int & value = op.code == YEAR ? year : ( op.code == MONTH ? month : day );
+        int digits = 0;
+        value = 0;
+        for ( int limit = op.code == YEAR ? 4 : 2; digits < limit && c >= '0' && c <= '9'; ++digits, c = source->snextc() )
+        {
+            value = value * 10 + ( c - '0' );
+        }
+
+        if ( ! digits )
+        {
+            if ( c == eof )
+            {
+                iss.setstate( ios::eofbit );
+            }
+            return false;
+        }
+    }
+
+    if ( source->sgetc() == eof )
+    {
+        iss.setstate( ios::eofbit );
+    }
+
+    return true;
 }
 //=================================================================================================
 class CDate
@@ -39,52 +352,52 @@ public:
      * @param month Month
      * @param day Day
      */
-    CDate ( int year, int month, int day );
+    constexpr CDate ( int year, int month, int day );
 
     /**
      * @brief Overloaded + operator
      * @param rhs Number of days to be added to current date
      * @return Updated date
      */
-    CDate operator + ( int rhs ) const;
+    constexpr CDate operator + ( int rhs ) const;
 
     /**
      * @brief Overloaded - operator
      * @param rhs Number of days to be deducted
      * @return Updated date
      */
-    CDate operator - ( int rhs ) const;
+    constexpr CDate operator - ( int rhs ) const;
 
     /**
      * @brief Overloaded - operator
      * @param other Second date
      * @return Number of days between the two dates
      */
-    int operator - ( CDate other ) const;
+    constexpr int operator - ( CDate other ) const;
 
     /**
      * @brief Overloaded prefix ++ operator
      * @return Reference to updated date
      */
-    CDate& operator++();
+    constexpr CDate& operator++();
 
     /**
      * @brief Overloaded postfix ++ operator
      * @return Copy of original date before update
      */
-    CDate operator++ ( int );
+    constexpr CDate operator++ ( int );
 
     /**
       * @brief Overloaded prefix -- operator
       * @return Reference to updated date
       */
-    CDate& operator--();
+    constexpr CDate& operator--();
 
     /**
      * @brief Overloaded postfix -- operator
      * @return Copy of original date before update
      */
-    CDate operator--(int);
+    constexpr CDate operator--(int);
 
 
     /**
@@ -92,42 +405,68 @@ public:
      * @param other Second date
      * @return True if both dates are same
      */
-    bool operator == ( CDate other ) const;
+    constexpr bool operator == ( CDate other ) const;
 
     /**
      * @brief Overloaded != operator
      * @param other Second date
      * @return True if both dates are different
      */
-    bool operator != ( CDate other ) const;
+    constexpr bool operator != ( CDate other ) const;
 
     /**
      * @brief Overloaded > operator
      * @param other Second date
      * @return True if the first date is later than second
      */
-    bool operator > ( CDate other ) const;
+    constexpr bool operator > ( CDate other ) const;
 
     /**
      * @brief Overloaded < operator
      * @param other Second date
      * @return True if the first date is earlier than second
      */
-    bool operator < ( CDate other ) const;
+    constexpr bool operator < ( CDate other ) const;
 
     /**
      * @brief Overloaded <= operator
      * @param other Second date
      * @return True if the first date is earlier or equal to second
      */
-    bool operator <= ( CDate other ) const;
+    constexpr bool operator <= ( CDate other ) const;
 
     /**
      * @brief Overloaded >= operator
      * @param other Second date
      * @return True if the first date is later or equal to second
      */
-    bool operator >= ( CDate other ) const;
+    constexpr bool operator >= ( CDate other ) const;
+
+    /**
+     * @brief Overloaded <=> operator
+     * @param other Second date
+     * @return Ordering of the day numbers
+     */
+    constexpr strong_ordering operator <=> ( CDate other ) const;
+
+    /**
+     * @brief Ordering key, an unsigned integer monotonic in the date ( also for dates shifted out of the supported range )
+     * @return Key of the date
+     */
+    constexpr uint32_t key ( void ) const;
+
+    /**
+     * @brief Day of the week
+     * @return 1 for Monday to 7 for Sunday ( ISO 8601 )
+     */
+    constexpr int weekday ( void ) const;
+
+    /**
+     * @brief Sorts dates by LSD radix sort on their keys ( 11-bit digits, passes only over the range of the keys )
+     * @param dates Dates to be sorted
+     * @param threads Number of threads for histograms and scatters of large arrays
+     */
+    static void sortDates ( span<CDate> dates, unsigned threads = 1 );
 
     /**
      * @brief Overloaded left bitwise operator
@@ -146,18 +485,182 @@ public:
 
     friend istream & operator >> ( istream & iss, CDate & self );
 
+    /**
+     * @brief Maximum number of characters written by toChars
+     */
+    static constexpr size_t MAX_CHARS = 20;
+
+    /**
+     * @brief Parses a date in ISO format ( %Y-%m-%d ) from the start of a buffer, no locale, no allocation.
+     *        Stricter than operator >>, no whitespace is skipped and fields have no '+' sign ( as by from_chars )
+     * @param first Start of the buffer
+     * @param last End of the buffer
+     * @param date Parsed date, it is left unchanged on failure
+     * @return Pointer after the parsed date and errc() on success, first and errc::invalid_argument otherwise ( format, invalid date )
+     */
+    static from_chars_result fromChars ( const char * first, const char * last, CDate & date );
+
+    /**
+     * @brief Parses a whole string in ISO format ( %Y-%m-%d ), as strict as fromChars ( e.g. " 2000-01-01" and "+2000-01-01" fail )
+     * @param text Text to be parsed
+     * @param date Parsed date, it is left unchanged on failure
+     * @return True if the whole text is a valid date
+     */
+    static bool parse ( string_view text, CDate & date );
+
+    /**
+     * @brief Writes the date in ISO format ( %Y-%m-%d ), no locale, no allocation, no terminating zero
+     * @param buffer Output buffer with at least MAX_CHARS characters
+     * @return Pointer after the last written character
+     */
+    char * toChars ( char * buffer ) const;
+
+    /**
+     * @brief Distance of two dates in a buffer for parseBatch ( YYYY-MM-DD and one delimiter )
+     */
+    static constexpr size_t BATCH_STRIDE = 11;
+
+    /**
+     * @brief Number of bits of one digit of sortDates
+     */
+    static constexpr int RADIX_BITS = 11;
+
+    /**
+     * @brief Arrays shorter than this are sorted by std::sort in sortDates
+     */
+    static constexpr size_t RADIX_MIN_SIZE = 256;
+
+    /**
+     * @brief Parses a buffer of fixed-width ISO dates ( YYYY-MM-DD ), each followed by one delimiter character ( optional after the last one ).
+     *        With AVX2 ( e.g. -mavx2 ) 16 entries are parsed per step, the format is checked by byte compares of 2 entries per register,
+     *        month lengths are looked up by permutes and the conversion runs on 8 dates per register. Entries, which don't fit a full step,
+     *        and all entries without AVX2 are parsed one at a time, 8 characters as one 64-bit word ( SWAR ), without branches.
+     * @param buffer Start of the buffer ( e.g. a memory mapped file )
+     * @param length Length of the buffer
+     * @param dates Output array with at least ( length + BATCH_STRIDE - 1 ) / BATCH_STRIDE dates, invalid entries are left unchanged
+     * @param invalid Indices of all invalid entries are appended here ( format, invalid date, incomplete last entry )
+     * @return Number of entries in the buffer
+     */
+    static size_t parseBatch ( const char * buffer, size_t length, CDate * dates, vector<size_t> & invalid );
+
+    /**
+     * @brief Batch kernels below are plain loops without branches, table lookups or divisions ( constant divisors are multiplications ),
+     *        GCC vectorizes all of them at -O3, with AVX2 for -mavx2, the scalar loop is the fallback ( e.g. -O2 ).
+     *        Only the common length of all spans is processed.
+     */
+
+    /**
+     * @brief Shifts every date by its offset, dates[i] = dates[i] + offsets[i]
+     * @param dates Dates to be shifted
+     * @param offsets Number of days for every date
+     */
+    static void addDays ( span<CDate> dates, span<const int> offsets );
+
+    /**
+     * @brief Counts days between pairs of dates, result[i] = first[i] - second[i] ( same as operator -, i.e. number of days between them )
+     * @param first First dates
+     * @param second Second dates
+     * @param result Number of days between the dates
+     */
+    static void diffDays ( span<const CDate> first, span<const CDate> second, span<int> result );
+
+    /**
+     * @brief Compares pairs of dates
+     * @param first First dates
+     * @param second Second dates
+     * @param order -1 if first[i] < second[i], 0 if they are equal, 1 if first[i] > second[i]
+     */
+    static void compare ( span<const CDate> first, span<const CDate> second, span<signed char> order );
+
+    /**
+     * @brief Converts dates to year, month and day
+     * @param dates Dates to be converted
+     * @param years Years of the dates
+     * @param months Months of the dates
+     * @param days Days of the dates
+     */
+    static void toCivil ( span<const CDate> dates, span<int> years, span<int> months, span<int> days );
+
+    /**
+     * @brief Converts year, month and day to dates, invalid entries are left unchanged
+     * @param years Years of the dates
+     * @param months Months of the dates
+     * @param days Days of the dates
+     * @param dates Converted dates
+     * @param valid Set to 1 for valid entries, 0 for invalid ones
+     * @return Number of invalid entries
+     */
+    static size_t fromCivil ( span<const int> years, span<const int> months, span<const int> days, span<CDate> dates, span<unsigned char> valid );
+
 private:
 
-    int year,
-        month,
-        day;
+    /**
+     * @brief Supported range of years ( proleptic Gregorian calendar )
+     */
+    static constexpr int MIN_YEAR = 1;
+    static constexpr int MAX_YEAR = 9999;
+
+    /**
+     * @brief Number of days in a year before the start of each month, [ leap year ][ month - 1 ], the last column is the length of the year
+     */
+    static constexpr int DAYS_BEFORE_MONTH[2][13] = {
+        { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334, 365 },
+        { 0, 31, 60, 91, 121, 152, 182, 213, 244, 274, 305, 335, 366 }
+    };
+
+    /**
+     * @brief Number of days since 2000-01-01 ( 0 for 2000-01-01 itself )
+     */
+    int serial;
+
+    friend class CPackedDate;
+    friend class CDateColumn;
+    friend class CDateRange;
+    friend class CBusinessCalendar;
+
+    /**
+     * @brief Converts a date to number of days since 2000-01-01, checks whether the date is valid
+     * @param year Year of the date
+     * @param month Month of the date
+     * @param day Day of the date
+     * @return Number of days since 2000-01-01
+     * @throws InvalidDateException if the date is not valid
+     */
+    static constexpr int checkedDays ( int year, int month, int day );
+
+    /**
+     * @brief Converts a date to number of days since 2000-01-01 without branches ( for batch loops ),
+     *        the month is clamped to a valid one, so that even garbage input is converted safely
+     * @param year Year of the date
+     * @param month Month of the date
+     * @param day Day of the date
+     * @param ok Set to false if the date is not valid ( left as is otherwise )
+     * @return Number of days since 2000-01-01, meaningful for valid dates only
+     */
+    static constexpr int uncheckedDays ( int year, int month, int day, bool & ok );
+
+#ifdef __AVX2__
+    /**
+     * @brief Parses 16 entries of parseBatch by AVX2, 2 entries per register for the format, 8 per register for validation and conversion
+     * @param buffer Start of the first entry, 16 bytes from the start of every entry have to be readable
+     * @param dates Output dates, invalid entries are left unchanged
+     * @param valid Set to 1 for valid entries, 0 otherwise
+     */
+    static void parseBatch16 ( const char * buffer, CDate * dates, unsigned char * valid );
+#endif /* __AVX2__ */
+
+    /**
+     * @brief Constructor from a day number, without any validation
+     * @param serial Number of days since 2000-01-01
+     */
+    constexpr explicit CDate ( int serial );
 
     /**
      * @brief Checks whether the year is leap
      * @param year Year to be checked
      * @return True if the year is leap
      */
-    bool isLeapYear ( int year ) const;
+    constexpr static bool isLeapYear ( int year );
 
     /**
      * @brief Checks how many days are in the chosen month
@@ -165,21 +668,34 @@ private:
      * @param year Year of the date
      * @return Number of days in the chosen month
      */
-    int daysInMonth ( int month, int year ) const;
+    constexpr static int daysInMonth ( int month, int year );
 
     /**
      * @brief Checks whether the date is valid
-     * @param date Date to be checked
+     * @param year Year of the date
+     * @param month Month of the date
+     * @param day Day of the date
      * @return True if the date is valid
      */
-    bool validDate ( CDate date ) const;
+    constexpr static bool validDate ( int year, int month, int day );
+
+    /**
+     * @brief Converts a date to number of days since 2000-01-01 ( closed-form, civil calendar in 400-year eras starting in March )
+     * @param year Year of the date
+     * @param month Month of the date
+     * @param day Day of the date
+     * @return Number of days since 2000-01-01
+     */
+    constexpr static int daysFromCivil ( int year, int month, int day );
 
     /**
-     * @brief Calculates number of days since start of year 2000
-     * @param date Date to be used
-     * @return Number of days since start of 2000
+     * @brief Converts a number of days since 2000-01-01 back to year, month and day ( closed-form inverse of daysFromCivil )
+     * @param serial Number of days since 2000-01-01
+     * @param year Year of the date
+     * @param month Month of the date
+     * @param day Day of the date
      */
-    int daysFromStart ( CDate date ) const;
+    constexpr static void civilFromDays ( int serial, int & year, int & month, int & day );
 
 };
 
@@ -187,198 +703,1902 @@ private:
 
 ostream & operator << ( ostream & os, CDate self )
 {
-    os << self.year;
-    os << "-";
-    ( self.month <= 9 )? os << "0" << self.month : os << self.month;
-    os << "-";
-    ( self.day   <= 9 )? os << "0" << self.day : os << self.day;
-    return os;
+    if ( const date_format * format = date_format::current( os ) )
+    {
+        int year, month, day;
+        CDate::civilFromDays( self.serial, year, month, day );
+        format->write( os, year, month, day );
+        return os;
+    }
+
+    char buffer[CDate::MAX_CHARS];
+    return os.write( buffer, self.toChars( buffer ) - buffer );
 }
 
 istream &operator >> ( istream & iss, CDate & self )
 {
-    char delim1, delim2;
-    CDate tmp = self;
-
-    if ( ( ! ( iss >> tmp.year >> delim1 >> tmp.month >> delim2 >> tmp.day )) || delim1 != '-' || delim2 != '-' || ! self.validDate( tmp ))
+    // Skips the leading whitespace as the extraction of numbers does
+    istream::sentry guard ( iss );
+    if ( ! guard )
     {
-        iss.setstate(ios::failbit);
         return iss;
     }
 
-    self = tmp;
-    return iss;
-}
-
-CDate::CDate( int year, int month, int day )
-{
-    if ( ! ( month >= 1 && month   <= 12                           &&
-             day   >= 1 && day     <= daysInMonth( month, year )   &&
-             year  >= 2000 && year <= 2030 ) )
+    if ( const date_format * format = date_format::current( iss ) )
     {
-        throw InvalidDateException();
-    }
+        int year, month, day;
+        if ( ! format->read( iss, year, month, day ) || ! CDate::validDate( year, month, day ) )
+        {
+            iss.setstate(ios::failbit);
+            return iss;
+        }
 
-    this->year = year;
-    this->month = month;
-    this->day = day;
-}
+        self.serial = CDate::daysFromCivil( year, month, day );
+        return iss;
+    }
 
-CDate CDate::operator + ( int rhs ) const
-{
-    CDate newDate ( this->year, this->month, this->day );
-    newDate.day += rhs;
+    // Same grammar as extraction of three numbers and two characters ( year >> delim >> month >> delim >> day ):
+    // whitespace may precede every field and separator ( if skipws is set ), numbers may have a sign, any characters
+    // are read as separators and checked only after the day, so a failing input is consumed as far as by the extractions
+    streambuf * source = iss.rdbuf();
+    const int eof = char_traits<char>::eof();
+    const bool skipWhitespace = iss.flags() & ios::skipws;
+    const ctype<char> * classes = nullptr;
+    int fields[3];
+    int separators[2];
+    int c = source->sgetc();
 
-    while ( !( validDate( newDate )) )
+    for ( int field = 0; field < 3; ++field )
     {
-        if ( newDate.day < 1 )
+        for ( bool separator = field > 0; ; separator = false )
         {
-            newDate.month -= 1;
-            if ( newDate.month == 0 )
+            // The locale is consulted only for characters, which can't continue the date
+            while ( skipWhitespace && c != eof && ( c < '0' || c > '9' ) && c != '-' && c != '+' )
             {
-                newDate.month = 12;
-                newDate.year -= 1;
+                if ( ! classes )
+                {
+                    classes = & use_facet<ctype<char>>( iss.getloc() );
+                }
+                if ( ! classes->is( ctype_base::space, (char) c ) )
+                {
+                    break;
+                }
+                c = source->snextc();
             }
-            newDate.day += daysInMonth( newDate.month, newDate.year );
-        }
 
-        if ( newDate.day > daysInMonth( newDate.month, newDate.year ))
-        {
-            newDate.day -= daysInMonth( newDate.month, newDate.year );
-            newDate.month += 1;
-            if ( newDate.month == 13 )
+            if ( ! separator )
             {
-                newDate.month = 1;
-                newDate.year += 1;
+                break;
             }
-        }
+            if ( c == eof )
+            {
+                iss.setstate( ios::failbit | ios::eofbit );
+                return iss;
+            }
+            separators[field - 1] = c;
+            c = source->snextc();
+        }
+
+        bool negative = c == '-';
+        if ( c == '-' || c == '+' )
+        {
+            c = source->snextc();
+        }
+
+        long long value = 0;
+        int digits = 0;
+        for ( ; c >= '0' && c <= '9'; c = source->snextc(), ++digits )
+        {
+            // Saturates above INT_MIN, the number is out of range anyway then
+            value = min( value * 10 + ( c - '0' ), (long long) INT_MAX + 2 );
+        }
+
+        if ( ! digits || value > (long long) INT_MAX + negative )
+        {
+            iss.setstate( c == eof ? ios::failbit | ios::eofbit : ios::failbit );
+            return iss;
+        }
+        fields[field] = negative ? (int) - value : (int) value;
+    }
+
+    if ( c == eof )
+    {
+        iss.setstate( ios::eofbit );
+    }
+
+    if ( separators[0] != '-' || separators[1] != '-' || ! CDate::validDate( fields[0], fields[1], fields[2] ) )
+    {
+        iss.setstate(ios::failbit);
+        return iss;
+    }
+
+    self.serial = CDate::daysFromCivil( fields[0], fields[1], fields[2] );
+    return iss;
+}
+
+from_chars_result CDate::fromChars( const char * first, const char * last, CDate & date )
+{
+    int year, month, day;
+    const from_chars_result failure { first, errc::invalid_argument };
+
+    auto result = from_chars( first, last, year );
+    if ( result.ec != errc() || result.ptr == last || * result.ptr != '-' )
+    {
+        return failure;
+    }
+
+    result = from_chars( result.ptr + 1, last, month );
+    if ( result.ec != errc() || result.ptr == last || * result.ptr != '-' )
+    {
+        return failure;
+    }
+
+    result = from_chars( result.ptr + 1, last, day );
+    if ( result.ec != errc() || ! validDate( year, month, day ) )
+    {
+        return failure;
+    }
+
+    date.serial = daysFromCivil( year, month, day );
+    return result;
+}
+
+bool CDate::parse( string_view text, CDate & date )
+{
+    CDate parsed = date;
+    auto result = fromChars( text.data(), text.data() + text.size(), parsed );
+
+    if ( result.ec != errc() || result.ptr != text.data() + text.size() )
+    {
+        return false;
+    }
+
+    date = parsed;
+    return true;
+}
+
+char * CDate::toChars( char * buffer ) const
+{
+    int year, month, day;
+    civilFromDays( serial, year, month, day );
+
+    // Year as a plain number ( dates shifted out of the supported range are still printable ), month and day with 2 digits
+    buffer = to_chars( buffer, buffer + MAX_CHARS - 6, year ).ptr;
+    buffer[0] = '-';
+    buffer[1] = (char) ( '0' + month / 10 );
+    buffer[2] = (char) ( '0' + month % 10 );
+    buffer[3] = '-';
+    buffer[4] = (char) ( '0' + day / 10 );
+    buffer[5] = (char) ( '0' + day % 10 );
+    return buffer + 6;
+}
+
+size_t CDate::parseBatch( const char * buffer, size_t length, CDate * dates, vector<size_t> & invalid )
+{
+    const size_t count = ( length + BATCH_STRIDE - 1 ) / BATCH_STRIDE;
+    const size_t complete = ( length + 1 ) / BATCH_STRIDE;
+
+    // "YYYY-MM-" as one little-endian word, separators are replaced by '0' for the digit check
+    const uint64_t separatorMask = 0xFF0000FF00000000ull;
+    const uint64_t separators    = 0x2D00002D00000000ull;
+    const uint64_t zeros         = 0x3030303030303030ull;
+    const uint64_t highNibbles   = 0xF0F0F0F0F0F0F0F0ull;
+
+    vector<unsigned char> valid ( complete );
+    size_t i = 0;
+
+#ifdef __AVX2__
+    // 16 entries per step, every entry is loaded as 16 bytes, so the step has to end 16 bytes before the end of the buffer
+    for ( ; i + 16 <= complete && ( i + 15 ) * BATCH_STRIDE + 16 <= length; i += 16 )
+    {
+        parseBatch16( buffer + i * BATCH_STRIDE, dates + i, & valid[i] );
+    }
+#endif /* __AVX2__ */
+
+    // The rest of entries ( all of them without AVX2 ) 8 characters at a time ( SWAR )
+    for ( ; i < complete; ++i )
+    {
+        const unsigned char * entry = (const unsigned char *) buffer + i * BATCH_STRIDE;
+
+        uint64_t word = 0;
+        for ( int byte = 0; byte < 8; ++byte )
+        {
+            word |= (uint64_t) entry[byte] << ( 8 * byte );
+        }
+        uint64_t tail = entry[8] | ( entry[9] << 8 );
+
+        // All 10 characters are digits except of the 2 separators
+        uint64_t digits = ( word & ~ separatorMask ) | ( zeros & separatorMask );
+        // ( a digit has the high nibble 3 and stays so after adding 6 )
+        bool format = ( ( word & separatorMask ) == separators )
+                    & ( ( ( digits & highNibbles ) | ( ( ( digits + 0x0606060606060606ull ) & highNibbles ) >> 4 ) ) == 0x3333333333333333ull )
+                    & ( ( ( tail & 0xF0F0 ) | ( ( ( tail + 0x0606 ) & 0xF0F0 ) >> 4 ) ) == 0x3333 );
+
+        digits -= zeros;
+        tail   -= 0x3030;
+        int year  = (int) ( ( digits & 0xFF ) * 1000 + ( ( digits >> 8 ) & 0xFF ) * 100 + ( ( digits >> 16 ) & 0xFF ) * 10 + ( ( digits >> 24 ) & 0xFF ) );
+        int month = (int) ( ( ( digits >> 40 ) & 0xFF ) * 10 + ( ( digits >> 48 ) & 0xFF ) );
+        int day   = (int) ( ( tail & 0xFF ) * 10 + ( ( tail >> 8 ) & 0xFF ) );
+
+        bool ok = format;
+        int serial = uncheckedDays( year, month, day, ok );
+        dates[i].serial = ok ? serial : dates[i].serial;
+        valid[i] = ok;
+    }
+
+    // Report the invalid entries in a separate pass, the conversion loop stays without branches
+    for ( i = 0; i < complete; ++i )
+    {
+        if ( ! valid[i] )
+        {
+            invalid.push_back( i );
+        }
+    }
+    if ( count > complete )
+    {
+        invalid.push_back( complete );
+    }
+
+    return count;
+}
+
+#ifdef __AVX2__
+void CDate::parseBatch16( const char * buffer, CDate * dates, unsigned char * valid )
+{
+    // Characters of one entry in a 128-bit lane: Y Y Y Y - M M - D D
+    const __m256i zeros      = _mm256_set1_epi8( '0' );
+    const __m256i nine       = _mm256_set1_epi8( 9 );
+    const __m256i dash       = _mm256_set1_epi8( '-' );
+    // Digits moved to Y Y Y Y M M D D, pairs joined by maddubs ( 10, 1 ) and then by madd to year and month * 128 + day
+    const __m256i gather     = _mm256_setr_epi8( 0, 1, 2, 3, 5, 6, 8, 9, -1, -1, -1, -1, -1, -1, -1, -1,
+                                                 0, 1, 2, 3, 5, 6, 8, 9, -1, -1, -1, -1, -1, -1, -1, -1 );
+    const __m256i pairs      = _mm256_setr_epi8( 10, 1, 10, 1, 10, 1, 10, 1, 0, 0, 0, 0, 0, 0, 0, 0,
+                                                 10, 1, 10, 1, 10, 1, 10, 1, 0, 0, 0, 0, 0, 0, 0, 0 );
+    const __m256i fields     = _mm256_setr_epi16( 100, 1, 128, 1, 0, 0, 0, 0, 100, 1, 128, 1, 0, 0, 0, 0 );
+    // Months 1 - 8 and 9 - 12 of non-leap years for permutes
+    const __m256i beforeLow  = _mm256_setr_epi32( 0, 31, 59, 90, 120, 151, 181, 212 );
+    const __m256i beforeHigh = _mm256_setr_epi32( 243, 273, 304, 334, 0, 0, 0, 0 );
+    const __m256i lengthLow  = _mm256_setr_epi32( 31, 28, 31, 30, 31, 30, 31, 31 );
+    const __m256i lengthHigh = _mm256_setr_epi32( 30, 31, 30, 31, 0, 0, 0, 0 );
+    const __m256i order      = _mm256_setr_epi32( 0, 4, 1, 5, 2, 6, 3, 7 );
+    const __m256i bits       = _mm256_setr_epi32( 1, 2, 4, 8, 16, 32, 64, 128 );
+    const __m256i one        = _mm256_set1_epi32( 1 );
+    const __m256i three      = _mm256_set1_epi32( 3 );
+    const __m256i eight      = _mm256_set1_epi32( 8 );
+    const __m256i twelve     = _mm256_set1_epi32( 12 );
+
+    for ( int group = 0; group < 2; ++group )
+    {
+        __m256i values[4];
+        unsigned format = 0;
+        for ( int pair = 0; pair < 4; ++pair )
+        {
+            const char * entry = buffer + ( group * 8 + pair * 2 ) * BATCH_STRIDE;
+            __m256i text = _mm256_loadu2_m128i( (const __m128i *) ( entry + BATCH_STRIDE ), (const __m128i *) entry );
+            __m256i digits = _mm256_sub_epi8( text, zeros );
+
+            // Digits at 0 - 3, 5, 6, 8, 9 and separators at 4, 7 of both entries
+            unsigned digitMask = _mm256_movemask_epi8( _mm256_cmpeq_epi8( _mm256_min_epu8( digits, nine ), digits ) );
+            unsigned dashMask = _mm256_movemask_epi8( _mm256_cmpeq_epi8( text, dash ) );
+            unsigned low = ( digitMask & 0x36F ) == 0x36F && ( dashMask & 0x90 ) == 0x90;
+            unsigned high = ( ( digitMask >> 16 ) & 0x36F ) == 0x36F && ( ( dashMask >> 16 ) & 0x90 ) == 0x90;
+            format |= ( low | high << 1 ) << ( pair * 2 );
+
+            values[pair] = _mm256_madd_epi16( _mm256_maddubs_epi16( _mm256_shuffle_epi8( digits, gather ), pairs ), fields );
+        }
+
+        // Lanes are ( year, month * 128 + day, 0, 0 ), entries of a group end up in the order 0 2 4 6 1 3 5 7
+        __m256 first = _mm256_castsi256_ps( _mm256_unpacklo_epi64( values[0], values[1] ) );
+        __m256 second = _mm256_castsi256_ps( _mm256_unpacklo_epi64( values[2], values[3] ) );
+        __m256i year = _mm256_permutevar8x32_epi32( _mm256_castps_si256( _mm256_shuffle_ps( first, second, 0x88 ) ), order );
+        __m256i monthDay = _mm256_permutevar8x32_epi32( _mm256_castps_si256( _mm256_shuffle_ps( first, second, 0xDD ) ), order );
+        __m256i month = _mm256_srli_epi32( monthDay, 7 );
+        __m256i day = _mm256_and_si256( monthDay, _mm256_set1_epi32( 127 ) );
+
+        // Month is clamped to 1 for the lookup, so that even garbage is looked up safely
+        __m256i monthOk = _mm256_andnot_si256( _mm256_cmpgt_epi32( one, month ), _mm256_cmpgt_epi32( _mm256_add_epi32( twelve, one ), month ) );
+        __m256i index = _mm256_sub_epi32( _mm256_blendv_epi8( one, month, monthOk ), one );
+        __m256i highMonth = _mm256_cmpgt_epi32( index, _mm256_sub_epi32( eight, one ) );
+        __m256i before = _mm256_blendv_epi8( _mm256_permutevar8x32_epi32( beforeLow, index ), _mm256_permutevar8x32_epi32( beforeHigh, index ), highMonth );
+        __m256i monthLength = _mm256_blendv_epi8( _mm256_permutevar8x32_epi32( lengthLow, index ), _mm256_permutevar8x32_epi32( lengthHigh, index ), highMonth );
+
+        // Leap years, y / 100 == ( y * 5243 ) >> 19 for years up to 9999
+        __m256i century = _mm256_srli_epi32( _mm256_mullo_epi32( year, _mm256_set1_epi32( 5243 ) ), 19 );
+        __m256i byFour = _mm256_cmpeq_epi32( _mm256_and_si256( year, three ), _mm256_setzero_si256() );
+        __m256i notCentury = _mm256_xor_si256( _mm256_cmpeq_epi32( _mm256_mullo_epi32( century, _mm256_set1_epi32( 100 ) ), year ), _mm256_set1_epi32( -1 ) );
+        __m256i byFourCenturies = _mm256_cmpeq_epi32( _mm256_and_si256( century, three ), _mm256_setzero_si256() );
+        __m256i leap = _mm256_and_si256( byFour, _mm256_or_si256( notCentury, byFourCenturies ) );
+        __m256i february = _mm256_cmpeq_epi32( index, one );
+        // Masks are -1, so subtracting them adds the leap day
+        before = _mm256_sub_epi32( before, _mm256_and_si256( leap, _mm256_cmpgt_epi32( index, one ) ) );
+        monthLength = _mm256_sub_epi32( monthLength, _mm256_and_si256( leap, february ) );
+
+        __m256i ok = _mm256_and_si256( monthOk, _mm256_cmpgt_epi32( year, _mm256_setzero_si256() ) );
+        ok = _mm256_and_si256( ok, _mm256_cmpgt_epi32( day, _mm256_setzero_si256() ) );
+        ok = _mm256_andnot_si256( _mm256_cmpgt_epi32( day, monthLength ), ok );
+        ok = _mm256_and_si256( ok, _mm256_cmpeq_epi32( _mm256_and_si256( _mm256_set1_epi32( (int) format ), bits ), bits ) );
+
+        // Days since 2000-01-01 as in daysFromCivil, but with the days of all previous years counted directly
+        __m256i previous = _mm256_sub_epi32( year, one );
+        __m256i serial = _mm256_mullo_epi32( previous, _mm256_set1_epi32( 365 ) );
+        serial = _mm256_add_epi32( serial, _mm256_srai_epi32( previous, 2 ) );
+        serial = _mm256_sub_epi32( serial, _mm256_srli_epi32( _mm256_mullo_epi32( previous, _mm256_set1_epi32( 5243 ) ), 19 ) );
+        serial = _mm256_add_epi32( serial, _mm256_srli_epi32( _mm256_mullo_epi32( previous, _mm256_set1_epi32( 5243 ) ), 21 ) );
+        serial = _mm256_add_epi32( serial, _mm256_add_epi32( before, day ) );
+        serial = _mm256_sub_epi32( serial, _mm256_set1_epi32( 730120 ) );
+
+        __m256i * target = (__m256i *) ( dates + group * 8 );
+        _mm256_storeu_si256( target, _mm256_blendv_epi8( _mm256_loadu_si256( target ), serial, ok ) );
+
+        unsigned mask = (unsigned) _mm256_movemask_ps( _mm256_castsi256_ps( ok ) );
+        for ( int entry = 0; entry < 8; ++entry )
+        {
+            valid[group * 8 + entry] = ( mask >> entry ) & 1;
+        }
+    }
+}
+#endif /* __AVX2__ */
+
+void CDate::addDays( span<CDate> dates, span<const int> offsets )
+{
+    size_t count = min( dates.size(), offsets.size() );
+    for ( size_t i = 0; i < count; ++i )
+    {
+        dates[i].serial += offsets[i];
+    }
+}
+
+void CDate::diffDays( span<const CDate> first, span<const CDate> second, span<int> result )
+{
+    size_t count = min( { first.size(), second.size(), result.size() } );
+    for ( size_t i = 0; i < count; ++i )
+    {
+        int diff = first[i].serial - second[i].serial;
+        result[i] = diff < 0 ? - diff : diff;
+    }
+}
+
+void CDate::compare( span<const CDate> first, span<const CDate> second, span<signed char> order )
+{
+    size_t count = min( { first.size(), second.size(), order.size() } );
+    for ( size_t i = 0; i < count; ++i )
+    {
+        order[i] = (signed char) ( ( first[i].serial > second[i].serial ) - ( first[i].serial < second[i].serial ) );
+    }
+}
+
+void CDate::toCivil( span<const CDate> dates, span<int> years, span<int> months, span<int> days )
+{
+    size_t count = min( { dates.size(), years.size(), months.size(), days.size() } );
+    for ( size_t i = 0; i < count; ++i )
+    {
+        civilFromDays( dates[i].serial, years[i], months[i], days[i] );
+    }
+}
+
+size_t CDate::fromCivil( span<const int> years, span<const int> months, span<const int> days, span<CDate> dates, span<unsigned char> valid )
+{
+    size_t count = min( { years.size(), months.size(), days.size(), dates.size(), valid.size() } );
+    size_t invalid = 0;
+
+    for ( size_t i = 0; i < count; ++i )
+    {
+        bool ok = true;
+        int serial = uncheckedDays( years[i], months[i], days[i], ok );
+        dates[i].serial = ok ? serial : dates[i].serial;
+        valid[i] = ok;
+        invalid += ! ok;
+    }
+
+    return invalid;
+}
+
+void CDate::sortDates( span<CDate> dates, unsigned threads )
+{
+    size_t count = dates.size();
+    if ( count < RADIX_MIN_SIZE )
+    {
+        sort( dates.begin(), dates.end() );
+        return;
+    }
+
+    auto [ low, high ] = minmax_element( dates.begin(), dates.end() );
+    uint32_t minKey = low->key();
+    uint32_t range = high->key() - minKey;
+
+    // Every thread takes a contiguous chunk, counts of each thread are kept apart, so that the scatter is stable
+    threads = max( 1u, min<unsigned>( threads, (unsigned) ( count / ( 1u << 16 ) ) ) );
+    constexpr size_t RADIX = size_t( 1 ) << RADIX_BITS;
+    constexpr uint32_t MASK = RADIX - 1;
+    vector<size_t> counts ( threads * RADIX );
+    vector<CDate> buffer ( count, CDate ( 0 ) );
+    CDate * from = dates.data();
+    CDate * to = buffer.data();
+
+    auto forEachChunk = [ & ] ( auto && work )
+    {
+        vector<thread> workers;
+        for ( unsigned t = 1; t < threads; ++t )
+        {
+            workers.emplace_back( work, t, count * t / threads, count * ( t + 1 ) / threads );
+        }
+        work( 0u, (size_t) 0, count / threads );
+        for ( thread & worker : workers )
+        {
+            worker.join();
+        }
+    };
+
+    for ( int shift = 0; shift < 32 && ( range >> shift ); shift += RADIX_BITS )
+    {
+        fill( counts.begin(), counts.end(), 0 );
+        forEachChunk( [ & ] ( unsigned t, size_t first, size_t last )
+        {
+            size_t * histogram = & counts[t * RADIX];
+            for ( size_t i = first; i < last; ++i )
+            {
+                ++histogram[( ( from[i].key() - minKey ) >> shift ) & MASK];
+            }
+        } );
+
+        // A digit shared by all dates doesn't change the order, the pass is skipped
+        size_t offset = 0;
+        bool trivial = false;
+        for ( size_t digit = 0; digit < RADIX; ++digit )
+        {
+            size_t total = 0;
+            for ( unsigned t = 0; t < threads; ++t )
+            {
+                size_t current = counts[t * RADIX + digit];
+                counts[t * RADIX + digit] = offset + total;
+                total += current;
+            }
+            trivial |= total == count;
+            offset += total;
+        }
+        if ( trivial )
+        {
+            continue;
+        }
+
+        forEachChunk( [ & ] ( unsigned t, size_t first, size_t last )
+        {
+            size_t * position = & counts[t * RADIX];
+            for ( size_t i = first; i < last; ++i )
+            {
+                to[position[( ( from[i].key() - minKey ) >> shift ) & MASK]++] = from[i];
+            }
+        } );
+        swap( from, to );
+    }
+
+    if ( from != dates.data() )
+    {
+        copy( from, from + count, dates.data() );
+    }
+}
+
+constexpr CDate::CDate( int year, int month, int day )
+    : serial ( checkedDays( year, month, day ) )
+{
+}
+
+constexpr CDate::CDate( int serial )
+    : serial ( serial )
+{
+}
+
+constexpr CDate CDate::operator + ( int rhs ) const
+{
+    return CDate( serial + rhs );
+}
+
+constexpr CDate CDate::operator-(int rhs) const
+{
+    return CDate( serial - rhs );
+}
+
+constexpr int CDate::operator-(CDate other) const
+{
+    return serial > other.serial ? serial - other.serial : other.serial - serial;
+}
+
+constexpr CDate &CDate::operator ++ ()
+{
+    ++serial;
+    return *this;
+}
+
+constexpr CDate CDate::operator++(int)
+{
+    CDate old = *this;
+    ++serial;
+    return old;
+}
+
+constexpr CDate &CDate::operator--()
+{
+    --serial;
+    return *this;
+}
+
+constexpr CDate CDate::operator--(int)
+{
+    CDate old = *this;
+    --serial;
+    return old;
+}
+
+constexpr bool CDate::operator==(CDate other) const
+{
+    return serial == other.serial;
+}
+
+constexpr bool CDate::operator!=(CDate other) const
+{
+    return serial != other.serial;
+}
+
+constexpr bool CDate::operator>(CDate other) const
+{
+    return serial > other.serial;
+}
+
+constexpr bool CDate::operator<(CDate other) const
+{
+    return serial < other.serial;
+}
+
+constexpr bool CDate::operator<=(CDate other) const
+{
+    return serial <= other.serial;
+}
+
+constexpr bool CDate::operator>=(CDate other) const
+{
+    return serial >= other.serial;
+}
+
+constexpr strong_ordering CDate::operator<=>(CDate other) const
+{
+    return serial <=> other.serial;
+}
+
+constexpr uint32_t CDate::key() const
+{
+    // Flipping the sign bit maps signed day numbers to unsigned keys in the same order
+    return (uint32_t) serial ^ 0x80000000u;
+}
+
+constexpr bool CDate::isLeapYear(int year)
+{
+    if ( year % 4   != 0 ) { return false; }
+    if ( year % 100 != 0 ) { return true;  }
+    if ( year % 400 != 0 ) { return false; }
+    return true;
+}
+
+constexpr int CDate::daysInMonth(int month, int year)
+{
+    if ( month < 1 || month > 12 )
+    {
+        return 0;
+    }
+
+    const int * table = DAYS_BEFORE_MONTH[isLeapYear( year )];
+    return table[month] - table[month - 1];
+}
+
+constexpr bool CDate::validDate( int year, int month, int day )
+{
+    return ( year >= MIN_YEAR && year <= MAX_YEAR && month >= 1 && month <= 12 && day >= 1 && day <= daysInMonth( month, year ) );
+}
+
+constexpr int CDate::checkedDays( int year, int month, int day )
+{
+    if ( ! validDate( year, month, day ) )
+    {
+        throw InvalidDateException();
+    }
+
+    return daysFromCivil( year, month, day );
+}
+
+constexpr int CDate::uncheckedDays( int year, int month, int day, bool & ok )
+{
+    // Only arithmetic ( no table lookups, divisions by multiplication ), so that loops over it vectorize.
+    // Year, month and day are clamped, so that even garbage is converted safely
+    int clampedYear = min( max( year, MIN_YEAR ), MAX_YEAR );
+    int clampedMonth = min( max( month, 1 ), 12 );
+    int clampedDay = min( max( day, 1 ), 31 );
+    int century = ( clampedYear * 5243 ) >> 19;
+    int leap = ( ( clampedYear & 3 ) == 0 ) & ( ( century * 100 != clampedYear ) | ( ( century & 3 ) == 0 ) );
+
+    // Lengths of months minus 28, 2 bits per month from bit 2
+    int monthLength = 28 + ( ( 0x3BBEECC >> ( 2 * clampedMonth ) ) & 3 ) + ( leap & ( clampedMonth == 2 ) );
+    ok = ok & ( year == clampedYear ) & ( month == clampedMonth ) & ( day == clampedDay ) & ( day <= monthLength );
+
+    // Days before the month ( ( 367 * m - 362 ) / 12 counts February as 30 days ) and days of all previous years
+    int before = ( ( 367 * clampedMonth - 362 ) * 2731 >> 15 ) - ( clampedMonth > 2 ) * ( 2 - leap );
+    int previous = clampedYear - 1;
+    int years = 365 * previous + ( previous >> 2 ) - ( ( previous * 5243 ) >> 19 ) + ( ( previous * 5243 ) >> 21 );
+
+    // 730119 days from 0001-01-01 to 2000-01-01
+    return years + before + clampedDay - 1 - 730119;
+}
+
+constexpr int CDate::daysFromCivil( int year, int month, int day )
+{
+    // Years start in March, so the leap day is the last day of a year
+    year -= month <= 2;
+    int era = ( year >= 0 ? year : year - 399 ) / 400;
+    int yearOfEra = year - era * 400;
+    int dayOfYear = ( 153 * ( month > 2 ? month - 3 : month + 9 ) + 2 ) / 5 + day - 1;
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+
+    // 730425 days from 0000-03-01 to 2000-01-01
+    return era * 146097 + dayOfEra - 730425;
+}
+
+constexpr void CDate::civilFromDays( int serial, int & year, int & month, int & day )
+{
+    serial += 730425;
+    int era = ( serial >= 0 ? serial : serial - 146096 ) / 146097;
+    int dayOfEra = serial - era * 146097;
+    int yearOfEra = ( dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096 ) / 365;
+    int dayOfYear = dayOfEra - ( 365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100 );
+    int monthIndex = ( 5 * dayOfYear + 2 ) / 153;
+
+    day   = dayOfYear - ( 153 * monthIndex + 2 ) / 5 + 1;
+    month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+    year  = yearOfEra + era * 400 + ( month <= 2 );
+}
+
+//=================================================================================================
+/**
+ * @brief Date packed to 16 bits as number of days since a base date, the frame of reference. Any 65536 consecutive
+ *        days ( about 179 years ) can be packed, with the default base 2000-01-01 it covers 2000-01-01 to 2179-06-06.
+ *        Comparisons are a single compare of the day numbers, so they are meaningful only within the same base.
+ */
+class CPackedDate
+{
+public:
+
+    /**
+     * @brief Default constructor, the base date itself
+     */
+    constexpr CPackedDate ( void ) = default;
+
+    /**
+     * @brief Constructor from a date
+     * @param date Date to be packed
+     * @param base Base date of the packed range
+     * @throws InvalidDateException if the date is out of the packed range
+     */
+    constexpr explicit CPackedDate ( CDate date, CDate base = CDate( 0 ) );
+
+    /**
+     * @brief Checks whether the date can be packed
+     * @param date Date to be checked
+     * @param base Base date of the packed range
+     * @return True if the date is within the packed range
+     */
+    static constexpr bool fits ( CDate date, CDate base = CDate( 0 ) );
+
+    /**
+     * @brief Unpacks the date
+     * @param base Base date the date was packed with
+     * @return Date
+     */
+    constexpr CDate unpack ( CDate base = CDate( 0 ) ) const;
+
+    // Comparisons of the day numbers, a single integer compare each
+    constexpr bool operator == ( CPackedDate other ) const { return days == other.days; }
+    constexpr bool operator != ( CPackedDate other ) const { return days != other.days; }
+    constexpr bool operator <  ( CPackedDate other ) const { return days <  other.days; }
+    constexpr bool operator >  ( CPackedDate other ) const { return days >  other.days; }
+    constexpr bool operator <= ( CPackedDate other ) const { return days <= other.days; }
+    constexpr bool operator >= ( CPackedDate other ) const { return days >= other.days; }
+
+private:
+
+    /**
+     * @brief Number of days since the base date
+     */
+    uint16_t days = 0;
+
+    friend class CDateColumn;
+};
+
+/**
+ * @brief Column of packed dates stored contiguously, 2 bytes per date. The base date of the column is its earliest date,
+ *        so the column holds any dates spanning at most 65535 days. It either owns its dates or it is a read-only view
+ *        of an image written by save ( e.g. a memory mapped file ), the view is copied on the first modification.
+ */
+class CDateColumn
+{
+public:
+
+    /**
+     * @brief Size of the image header, magic number, base day number, largest offset and number of dates
+     */
+    static constexpr size_t HEADER_SIZE = 24;
+
+    /**
+     * @brief Appends a date, a date before the base date moves the base and shifts the stored dates
+     * @param date Date to be appended
+     * @throws InvalidDateException if the dates of the column would span more than 65535 days
+     */
+    void push_back ( CDate date );
+
+    /**
+     * @brief Appends dates, either all of them or none
+     * @param dates Dates to be appended
+     * @throws InvalidDateException if the dates of the column would span more than 65535 days, the column is left unchanged
+     */
+    void append ( span<const CDate> dates );
+
+    /**
+     * @brief Converts dates of the column to dates
+     * @param dates Converted dates, only the common length with the column is converted
+     */
+    void unpack ( span<CDate> dates ) const;
+
+    /**
+     * @brief Number of dates in the column
+     * @return Number of dates
+     */
+    size_t size ( void ) const { return packed().size(); }
+
+    /**
+     * @brief Date at the given index
+     * @param index Index of the date
+     * @return Unpacked date
+     */
+    CDate operator [] ( size_t index ) const { return packed()[index].unpack( base() ); }
+
+    /**
+     * @brief Base date the dates of the column are packed with
+     * @return Earliest date of the column, 2000-01-01 for an empty column
+     */
+    CDate base ( void ) const { return CDate( first ); }
+
+    /**
+     * @brief Packed dates of the column, relative to base
+     * @return Span over the own storage or over the mapped image
+     */
+    span<const CPackedDate> packed ( void ) const { return mapped ? view : span<const CPackedDate> ( storage ); }
+
+    /**
+     * @brief True if the column is a view of an external image
+     * @return True if the column doesn't own its dates
+     */
+    bool isMapped ( void ) const { return mapped; }
+
+    /**
+     * @brief Writes the image of the column, header and dates in the native byte order
+     * @param os Output stream
+     * @return Reference to the output stream
+     */
+    ostream & save ( ostream & os ) const;
+
+    /**
+     * @brief Maps an image written by save without copying the dates, the image has to outlive the column
+     * @param image Start of the image, aligned at least to 2 bytes ( true for mmap and heap buffers )
+     * @param size Size of the image in bytes
+     * @param column Column to be set to the view, left unchanged on failure
+     * @return True if the image is valid
+     */
+    static bool map ( const char * image, size_t size, CDateColumn & column );
+
+private:
+
+    /**
+     * @brief Magic number at the start of an image
+     */
+    static constexpr char MAGIC[8] = { 'C', 'D', 'A', 'T', 'E', 'C', 'O', 'L' };
+
+    vector<CPackedDate> storage;
+
+    /**
+     * @brief Dates of the mapped image, used if mapped is set
+     */
+    span<const CPackedDate> view;
+
+    /**
+     * @brief Day number of the base date
+     */
+    int first = 0;
+
+    /**
+     * @brief Largest packed day number in the column, kept so that appending doesn't scan the stored dates
+     */
+    int last = 0;
+
+    bool mapped = false;
+
+    /**
+     * @brief Copies the mapped image to the own storage before a modification
+     */
+    void own ( void );
+};
+
+static_assert ( sizeof ( CPackedDate ) == 2, "packed date takes 2 bytes" );
+
+constexpr CPackedDate::CPackedDate( CDate date, CDate base )
+    : days ( (uint16_t) ( date.serial - base.serial ) )
+{
+    if ( ! fits( date, base ) )
+    {
+        throw InvalidDateException();
+    }
+}
+
+constexpr bool CPackedDate::fits( CDate date, CDate base )
+{
+    return date.serial >= base.serial && (long long) date.serial - base.serial <= UINT16_MAX;
+}
+
+constexpr CDate CPackedDate::unpack( CDate base ) const
+{
+    return CDate( base.serial + days );
+}
+
+void CDateColumn::push_back( CDate date )
+{
+    append( span<const CDate>( & date, 1 ) );
+}
+
+void CDateColumn::append( span<const CDate> dates )
+{
+    if ( dates.empty() )
+    {
+        return;
+    }
+
+    // Bounds of the new dates without branches, so that nothing is appended if the span check fails
+    int low = INT_MAX, high = INT_MIN;
+    for ( CDate date : dates )
+    {
+        low = min( low, date.serial );
+        high = max( high, date.serial );
+    }
+    bool empty = size() == 0;
+    int newFirst = empty ? low : min( first, low );
+    long long newLast = empty ? high : max( (long long) first + last, (long long) high );
+    if ( newLast - newFirst > UINT16_MAX )
+    {
+        throw InvalidDateException();
+    }
+
+    own();
+    // A date before the base moves the base, the stored dates keep their day numbers
+    uint16_t shift = (uint16_t) ( first - newFirst );
+    if ( ! empty && shift )
+    {
+        for ( CPackedDate & packedDate : storage )
+        {
+            packedDate.days += shift;
+        }
+    }
+    first = newFirst;
+    last = (int) ( newLast - newFirst );
+
+    size_t start = storage.size();
+    storage.resize( start + dates.size() );
+    for ( size_t i = 0; i < dates.size(); ++i )
+    {
+        storage[start + i].days = (uint16_t) ( dates[i].serial - first );
+    }
+}
+
+void CDateColumn::unpack( span<CDate> dates ) const
+{
+    span<const CPackedDate> source = packed();
+    size_t count = min( source.size(), dates.size() );
+    for ( size_t i = 0; i < count; ++i )
+    {
+        dates[i].serial = first + source[i].days;
+    }
+}
+
+ostream & CDateColumn::save( ostream & os ) const
+{
+    span<const CPackedDate> source = packed();
+    int32_t header[2] = { first, last };
+    uint64_t count = source.size();
+    os.write( MAGIC, sizeof( MAGIC ) );
+    os.write( reinterpret_cast<const char *>( header ), sizeof( header ) );
+    os.write( reinterpret_cast<const char *>( & count ), sizeof( count ) );
+    return os.write( reinterpret_cast<const char *>( source.data() ), (streamsize) source.size_bytes() );
+}
+
+bool CDateColumn::map( const char * image, size_t size, CDateColumn & column )
+{
+    if ( size < HEADER_SIZE || ! equal( MAGIC, MAGIC + sizeof( MAGIC ), image )
+         || reinterpret_cast<uintptr_t>( image ) % alignof( CPackedDate ) )
+    {
+        return false;
+    }
+
+    int32_t header[2];
+    uint64_t count;
+    memcpy( header, image + sizeof( MAGIC ), sizeof( header ) );
+    memcpy( & count, image + sizeof( MAGIC ) + sizeof( header ), sizeof( count ) );
+    if ( count != ( size - HEADER_SIZE ) / sizeof( CPackedDate ) || ( size - HEADER_SIZE ) % sizeof( CPackedDate )
+         || header[1] < 0 || header[1] > UINT16_MAX || (long long) header[0] + header[1] > INT_MAX )
+    {
+        return false;
+    }
+
+    // CPackedDate is a trivially copyable wrapper of uint16_t, so the image is used in place. The largest offset
+    // is taken from the header rather than scanning the dates, so mapping stays O(1)
+    column.storage.clear();
+    column.view = span<const CPackedDate>( reinterpret_cast<const CPackedDate *>( image + HEADER_SIZE ), (size_t) count );
+    column.first = header[0];
+    column.last = header[1];
+    column.mapped = true;
+    return true;
+}
+
+void CDateColumn::own()
+{
+    if ( mapped )
+    {
+        storage.assign( view.begin(), view.end() );
+        view = {};
+        mapped = false;
+    }
+}
+
+//=================================================================================================
+/**
+ * @brief Lazy range of dates from a date to a date ( both inclusive ) with a step in days, weeks, months or months
+ *        to their last days. Dates are computed while iterating, each advance is O(1) without any validation.
+ */
+class CDateRange
+{
+public:
+
+    /**
+     * @brief Units of the step
+     */
+    enum EUnit { DAYS, WEEKS, MONTHS, END_OF_MONTH };
+
+    /**
+     * @brief End of any range, an iterator reaches it when it passes the last date
+     */
+    struct sentinel { };
+
+    /**
+     * @brief Forward iterator over the range, dates are returned by value
+     */
+    class iterator
+    {
+    public:
+        using iterator_category = forward_iterator_tag;
+        using value_type = CDate;
+        using difference_type = ptrdiff_t;
+        using pointer = const CDate *;
+        using reference = CDate;
+
+        /**
+         * @brief Default constructor, the end of any range
+         */
+        constexpr iterator ( void ) = default;
+
+        constexpr CDate operator * ( void ) const { return CDate( serial ); }
+
+        /**
+         * @brief Advances to the next date of the range, days and weeks are a single addition ( the month step is 0 )
+         * @return Reference to the iterator
+         */
+        constexpr iterator & operator ++ ( void )
+        {
+            serial += step;
+            if ( months )
+            {
+                advanceMonths();
+            }
+            return * this;
+        }
+
+        constexpr iterator operator ++ ( int ) { iterator copy = * this; ++ * this; return copy; }
+
+        /**
+         * @brief Iterators are equal if both are past the end of their ranges or both point to the same date
+         */
+        constexpr bool operator == ( const iterator & other ) const
+        {
+            bool done = serial > last, otherDone = other.serial > other.last;
+            return done == otherDone && ( done || serial == other.serial );
+        }
+
+        constexpr bool operator != ( const iterator & other ) const { return ! ( * this == other ); }
+
+        /**
+         * @brief The end of the range is a single compare with the last date
+         */
+        constexpr bool operator == ( sentinel ) const { return serial > last; }
+
+        constexpr bool operator != ( sentinel ) const { return serial <= last; }
+
+    private:
+        friend class CDateRange;
+
+        int serial = 0;
+        int last = -1;
+
+        /**
+         * @brief Step in days, 0 for month units
+         */
+        int step = 1;
+
+        /**
+         * @brief Step in months, 0 for day units
+         */
+        int months = 0;
+
+        // Month stepping only, the day of the first date is kept ( clamped to the length of the month )
+        bool endOfMonth = false;
+        int year = 0;
+        int month = 0;
+        int anchorDay = 0;
+
+        /**
+         * @brief Advances by months, kept out of operator ++ so that the day loops stay small
+         */
+        constexpr void advanceMonths ( void );
+    };
+
+    /**
+     * @brief Constructor
+     * @param from First date of the range ( the end of its month for END_OF_MONTH )
+     * @param to Last date of the range, inclusive
+     * @param step Size of the step in units
+     * @param unit Unit of the step
+     * @throws invalid_argument if the step is not positive
+     */
+    constexpr CDateRange ( CDate from, CDate to, int step = 1, EUnit unit = DAYS );
+
+    constexpr iterator begin ( void ) const { return first; }
+    constexpr sentinel end ( void ) const { return sentinel(); }
+
+private:
+
+    iterator first;
+};
+
+constexpr CDateRange::CDateRange( CDate from, CDate to, int step, EUnit unit )
+{
+    if ( step <= 0 )
+    {
+        throw invalid_argument( "step of a date range has to be positive" );
+    }
+
+    first.serial = from.serial;
+    first.last = to.serial;
+
+    if ( unit == DAYS || unit == WEEKS )
+    {
+        first.step = unit == WEEKS ? 7 * step : step;
+    }
+    else
+    {
+        first.step = 0;
+        first.months = step;
+        first.endOfMonth = unit == END_OF_MONTH;
+        CDate::civilFromDays( from.serial, first.year, first.month, first.anchorDay );
+        if ( unit == END_OF_MONTH )
+        {
+            first.serial += CDate::daysInMonth( first.month, first.year ) - first.anchorDay;
+        }
+    }
+}
+
+constexpr void CDateRange::iterator::advanceMonths()
+{
+    month += months;
+    year += ( month - 1 ) / 12;
+    month = ( month - 1 ) % 12 + 1;
+
+    int length = CDate::daysInMonth( month, year );
+    int day = endOfMonth || anchorDay > length ? length : anchorDay;
+    serial = CDate::daysFromCivil( year, month, day );
+}
+
+constexpr int CDate::weekday() const
+{
+    // 2000-01-01 was Saturday
+    int index = ( serial + 5 ) % 7;
+    return ( index < 0 ? index + 7 : index ) + 1;
+}
+
+//=================================================================================================
+/**
+ * @brief Calendar of working days over a range of dates. Working days are kept in a day-indexed bitmap with counts
+ *        of working days before every 64-bit word ( rank ) and a table of all working days ( select ), so that both
+ *        the arithmetic and the counting of working days are O(1).
+ */
+class CBusinessCalendar
+{
+public:
+
+    /**
+     * @brief Saturday and Sunday, bit ( weekday - 1 ) is set for every day of the weekend
+     */
+    static constexpr unsigned DEFAULT_WEEKEND = ( 1u << 5 ) | ( 1u << 6 );
+
+    /**
+     * @brief Constructor
+     * @param from First date of the calendar
+     * @param to Last date of the calendar, inclusive
+     * @param holidays Holidays, dates out of the calendar are ignored
+     * @param weekend Days of the weekend, bit ( weekday - 1 ) for every day
+     * @throws invalid_argument if the range is empty
+     */
+    CBusinessCalendar ( CDate from, CDate to, span<const CDate> holidays = {}, unsigned weekend = DEFAULT_WEEKEND );
+
+    /**
+     * @brief Replaces all holidays, the storage is reused
+     * @param holidays Holidays, dates out of the calendar are ignored
+     */
+    void setHolidays ( span<const CDate> holidays );
+
+    /**
+     * @brief Checks whether the date is a working day
+     * @param date Date to be checked
+     * @return True if the date is a working day
+     * @throws out_of_range if the date is out of the calendar
+     */
+    bool isBusinessDay ( CDate date ) const;
+
+    /**
+     * @brief Shifts a date by working days, e.g. a due date 14 working days after an invoice
+     * @param date Start date, it doesn't have to be a working day
+     * @param days Number of working days, the n-th working day after the date for positive, before the date for negative,
+     *             the date itself for 0
+     * @return Shifted date
+     * @throws out_of_range if the date or the result is out of the calendar
+     */
+    CDate addBusinessDays ( CDate date, int days ) const;
+
+    /**
+     * @brief Counts working days after the first date up to the second one, inverse of addBusinessDays for positive days
+     * @param from First date ( not counted )
+     * @param to Second date ( counted )
+     * @return Number of working days in ( from, to ], negative if to is before from
+     * @throws out_of_range if any of the dates is out of the calendar
+     */
+    int businessDaysBetween ( CDate from, CDate to ) const;
+
+    /**
+     * @brief Batch version of addBusinessDays, only the common length of all spans is processed
+     * @param dates Start dates
+     * @param days Number of working days for every date
+     * @param result Shifted dates
+     * @throws out_of_range if any date or result is out of the calendar, the results before it are written
+     */
+    void addBusinessDays ( span<const CDate> dates, span<const int> days, span<CDate> result ) const;
+
+    /**
+     * @brief Batch version of businessDaysBetween, only the common length of all spans is processed
+     * @param from First dates
+     * @param to Second dates
+     * @param result Numbers of working days
+     * @throws out_of_range if any date is out of the calendar, the results before it are written
+     */
+    void businessDaysBetween ( span<const CDate> from, span<const CDate> to, span<int> result ) const;
+
+private:
+
+    /**
+     * @brief Day number of the first date of the calendar
+     */
+    int first;
+
+    /**
+     * @brief Number of days of the calendar
+     */
+    int length;
+
+    unsigned weekend;
+
+    /**
+     * @brief Bit ( i % 64 ) of word i / 64 is set if day first + i is a working day
+     */
+    vector<uint64_t> bitmap;
+
+    /**
+     * @brief Number of working days before every word of the bitmap
+     */
+    vector<int> rank;
+
+    /**
+     * @brief Indices of all working days in ascending order
+     */
+    vector<int> select;
+
+    /**
+     * @brief Index of a date in the calendar
+     * @param date Date
+     * @return Index of the date
+     * @throws out_of_range if the date is out of the calendar
+     */
+    int indexOf ( CDate date ) const;
+
+    /**
+     * @brief Number of working days before an index
+     * @param index Index of a day, up to length
+     * @return Number of working days in [ 0, index )
+     */
+    int workingBefore ( int index ) const;
+};
+
+CBusinessCalendar::CBusinessCalendar( CDate from, CDate to, span<const CDate> holidays, unsigned weekend )
+    : first ( from.serial ), length ( to.serial - from.serial + 1 ), weekend ( weekend )
+{
+    if ( to < from )
+    {
+        throw invalid_argument( "empty business calendar" );
+    }
+
+    // One extra word, so that workingBefore ( length ) reads inside the bitmap
+    bitmap.resize( length / 64 + 1 );
+    rank.resize( bitmap.size() );
+    setHolidays( holidays );
+}
+
+void CBusinessCalendar::setHolidays( span<const CDate> holidays )
+{
+    // The weekend repeats every 7 days and 64 % 7 == 1, so word w of the bitmap is one of 7 patterns, the one for w % 7
+    uint64_t patterns[7] = {};
+    int firstWeekday = CDate( first ).weekday() - 1;
+    for ( int phase = 0; phase < 7; ++phase )
+    {
+        for ( int bit = 0; bit < 64; ++bit )
+        {
+            bool working = ! ( ( weekend >> ( ( firstWeekday + phase + bit ) % 7 ) ) & 1 );
+            patterns[phase] |= (uint64_t) working << bit;
+        }
+    }
+
+    for ( size_t word = 0; word < bitmap.size(); ++word )
+    {
+        bitmap[word] = patterns[word % 7];
+    }
+
+    // Days after the end of the calendar are not working days
+    bitmap[length / 64] &= ( uint64_t( 1 ) << ( length % 64 ) ) - 1;
+
+    for ( CDate holiday : holidays )
+    {
+        unsigned index = (unsigned) ( holiday.serial - first );
+        if ( index < (unsigned) length )
+        {
+            bitmap[index / 64] &= ~ ( uint64_t( 1 ) << ( index % 64 ) );
+        }
+    }
+
+    select.clear();
+    int count = 0;
+    for ( size_t word = 0; word < bitmap.size(); ++word )
+    {
+        rank[word] = count;
+        for ( uint64_t bits = bitmap[word]; bits; bits &= bits - 1 )
+        {
+            select.push_back( (int) ( 64 * word ) + countr_zero( bits ) );
+        }
+        count += popcount( bitmap[word] );
     }
+}
 
-    return newDate;
+bool CBusinessCalendar::isBusinessDay( CDate date ) const
+{
+    int index = indexOf( date );
+    return ( bitmap[index / 64] >> ( index % 64 ) ) & 1;
 }
 
-CDate CDate::operator-(int rhs) const
+CDate CBusinessCalendar::addBusinessDays( CDate date, int days ) const
 {
-    return ((*this) + ( - rhs ));
+    int index = indexOf( date );
+    if ( ! days )
+    {
+        return date;
+    }
+
+    // The n-th working day after the date has position ( working days up to the date ) + n - 1 in select
+    long long position = days > 0 ? (long long) workingBefore( index + 1 ) + days - 1 : (long long) workingBefore( index ) + days;
+    if ( position < 0 || position >= (long long) select.size() )
+    {
+        throw out_of_range( "date out of the business calendar" );
+    }
+    return CDate( first + select[position] );
 }
 
-int CDate::operator-(CDate other) const
+int CBusinessCalendar::businessDaysBetween( CDate from, CDate to ) const
 {
-    int order1 = daysFromStart( *this );
-    int order2 = daysFromStart( other );
-    return abs( order1 - order2 );
+    return workingBefore( indexOf( to ) + 1 ) - workingBefore( indexOf( from ) + 1 );
 }
 
-CDate &CDate::operator ++ ()
+void CBusinessCalendar::addBusinessDays( span<const CDate> dates, span<const int> days, span<CDate> result ) const
 {
-    *this = ( *this + 1 );
-    return *this;
+    size_t count = min( { dates.size(), days.size(), result.size() } );
+    for ( size_t i = 0; i < count; ++i )
+    {
+        result[i] = addBusinessDays( dates[i], days[i] );
+    }
 }
 
-CDate CDate::operator++(int)
+void CBusinessCalendar::businessDaysBetween( span<const CDate> from, span<const CDate> to, span<int> result ) const
 {
-    CDate old = *this;
-    *this = ( *this + 1 );
-    return old;
+    size_t count = min( { from.size(), to.size(), result.size() } );
+    for ( size_t i = 0; i < count; ++i )
+    {
+        result[i] = businessDaysBetween( from[i], to[i] );
+    }
 }
 
-CDate &CDate::operator--()
+int CBusinessCalendar::indexOf( CDate date ) const
 {
-    *this = ( *this - 1 );
-    return *this;
+    // A single unsigned compare covers dates before and after the calendar
+    unsigned index = (unsigned) ( date.serial - first );
+    if ( index >= (unsigned) length )
+    {
+        throw out_of_range( "date out of the business calendar" );
+    }
+    return (int) index;
 }
 
-CDate CDate::operator--(int)
+int CBusinessCalendar::workingBefore( int index ) const
 {
-    CDate old = *this;
-    *this = ( *this - 1 );
-    return old;
+    return rank[index / 64] + popcount( bitmap[index / 64] & ( ( uint64_t( 1 ) << ( index % 64 ) ) - 1 ) );
 }
 
-bool CDate::operator==(CDate other) const
+#ifndef __PROGTEST__
+// Calendar checks evaluated by the compiler
+static_assert ( CDate ( 2000, 1, 1 ) - CDate ( 1, 1, 1 ) == 730119, "days from 0001-01-01" );
+static_assert ( CDate ( 9999, 12, 31 ) - CDate ( 2000, 1, 1 ) == 2921939, "days to 9999-12-31" );
+static_assert ( CDate ( 1, 1, 1 ) + 730119 == CDate ( 2000, 1, 1 ), "adding across eras" );
+static_assert ( CDate ( 1600, 3, 1 ) - 1 == CDate ( 1600, 2, 29 ), "1600 is leap" );
+static_assert ( CDate ( 1900, 3, 1 ) - 1 == CDate ( 1900, 2, 28 ), "1900 is not leap" );
+static_assert ( CDate ( 2024, 3, 1 ) - CDate ( 2024, 2, 1 ) == 29, "2024 is leap" );
+static_assert ( CDate ( 2023, 12, 31 ) + 1 == CDate ( 2024, 1, 1 ), "end of year" );
+static_assert ( CDate ( 1582, 10, 4 ) + 1 == CDate ( 1582, 10, 5 ), "proleptic calendar" );
+static_assert ( CDate ( 2000, 1, 1 ) + 100 > CDate ( 2000, 4, 9 ) && CDate ( 2000, 1, 1 ) + 99 == CDate ( 2000, 4, 9 ), "comparisons" );
+static_assert ( ++ CDate ( 9999, 12, 30 ) == CDate ( 9999, 12, 31 ) && -- CDate ( 1, 1, 2 ) == CDate ( 1, 1, 1 ), "increment and decrement" );
+static_assert ( ( CDate ( 2000, 1, 1 ) <=> CDate ( 1999, 12, 31 ) ) > 0 && CDate ( 1, 1, 1 ) . key () < ( CDate ( 1, 1, 1 ) + 1 ) . key (), "ordering key" );
+static_assert ( ( CDate ( 1, 1, 1 ) - 1000000 ) . key () < CDate ( 2000, 1, 1 ) . key (), "key of out of range dates" );
+static_assert ( CDate ( 2000, 1, 1 ) . weekday () == 6 && CDate ( 1, 1, 1 ) . weekday () == 1 && CDate ( 2024, 12, 29 ) . weekday () == 7, "weekdays" );
+static_assert ( forward_iterator<CDateRange::iterator> && sentinel_for<CDateRange::sentinel, CDateRange::iterator>
+                && ranges::forward_range<CDateRange>, "date range is a forward range" );
+static_assert ( ranges::distance ( CDateRange ( CDate ( 2000, 1, 1 ), CDate ( 2099, 12, 31 ), 1, CDateRange::MONTHS ) ) == 1200, "months of a century" );
+static_assert ( CPackedDate ( CDate ( 2179, 6, 6 ) ) . unpack () == CDate ( 2179, 6, 6 ) && ! CPackedDate::fits ( CDate ( 2179, 6, 7 ) ), "packed range" );
+static_assert ( CPackedDate ( CDate ( 2030, 1, 1 ) ) > CPackedDate ( CDate ( 2029, 12, 31 ) ) && CPackedDate () == CPackedDate ( CDate ( 2000, 1, 1 ) ), "packed comparisons" );
+static_assert ( CPackedDate ( CDate ( 1620, 2, 29 ), CDate ( 1600, 1, 1 ) ) . unpack ( CDate ( 1600, 1, 1 ) ) == CDate ( 1620, 2, 29 )
+                && ! CPackedDate::fits ( CDate ( 1599, 12, 31 ), CDate ( 1600, 1, 1 ) ), "packed range of another base" );
+
+#ifdef BENCHMARK
+/**
+ * @brief Prints the throughput of one benchmark
+ * @param name Name of the benchmark
+ * @param count Number of processed dates
+ * @param start Start of the measurement
+ */
+static void printRate ( const char * name, size_t count, chrono::steady_clock::time_point start )
 {
-    return ( year == other.year && month == other.month && day == other.day );
+    double seconds = chrono::duration<double> ( chrono::steady_clock::now () - start ) . count ();
+    cout << setw ( 28 ) << left << name << right << setw ( 12 ) << (long long) ( count / seconds ) << " dates/s" << endl;
 }
 
-bool CDate::operator!=(CDate other) const
+/**
+ * @brief Compares stream and character based parsing and formatting of ISO dates
+ */
+static void benchmarkParseFormat ( void )
 {
-    return !( *this == other );
+    const int count = 1000000;
+    string text;
+    CDate date ( 1990, 1, 1 );
+    for ( int i = 0; i < count; ++i )
+    {
+        char buffer[CDate::MAX_CHARS];
+        text . append ( buffer, ( date + i % 20000 ) . toChars ( buffer ) );
+        text . push_back ( '\n' );
+    }
+
+    long long checksum = 0;
+
+    auto start = chrono::steady_clock::now ();
+    istringstream iss ( text );
+    CDate parsed ( 2000, 1, 1 );
+    while ( iss >> parsed )
+    {
+        checksum += parsed - date;
+    }
+    printRate ( "operator >>", count, start );
+
+    start = chrono::steady_clock::now ();
+    for ( const char * pos = text . data (), * end = text . data () + text . size (); pos < end; )
+    {
+        pos = CDate::fromChars ( pos, end, parsed ) . ptr + 1;
+        checksum -= 2 * ( parsed - date );
+    }
+    printRate ( "CDate::fromChars", count, start );
+
+    start = chrono::steady_clock::now ();
+    ostringstream oss;
+    for ( int i = 0; i < count; ++i )
+    {
+        oss << date + i % 20000 << '\n';
+    }
+    printRate ( "operator <<", count, start );
+
+    start = chrono::steady_clock::now ();
+    ostringstream formatted;
+    formatted << date_format ( "%d.%m.%Y" );
+    for ( int i = 0; i < count; ++i )
+    {
+        formatted << date + i % 20000 << '\n';
+    }
+    printRate ( "operator << ( date_format )", count, start );
+
+    start = chrono::steady_clock::now ();
+    istringstream formattedIn ( formatted . str () );
+    formattedIn >> date_format ( "%d.%m.%Y" );
+    while ( formattedIn >> parsed )
+    {
+        checksum += parsed - date;
+    }
+    printRate ( "operator >> ( date_format )", count, start );
+
+    start = chrono::steady_clock::now ();
+    string out ( (size_t) count * ( CDate::MAX_CHARS + 1 ), ' ' );
+    char * pos = & out[0];
+    for ( int i = 0; i < count; ++i )
+    {
+        pos = ( date + i % 20000 ) . toChars ( pos );
+        * pos ++ = '\n';
+    }
+    out . resize ( pos - out . data () );
+    printRate ( "CDate::toChars", count, start );
+
+    assert ( checksum == 0 && out == oss . str () );
+
+    // Fixed-width dates as in a memory mapped file
+    string fixed;
+    for ( int i = 0; i < count; ++i )
+    {
+        char buffer[CDate::MAX_CHARS];
+        fixed . append ( buffer, ( date + i % 20000 ) . toChars ( buffer ) );
+        fixed . push_back ( '\n' );
+    }
+
+    start = chrono::steady_clock::now ();
+    iss . clear ();
+    iss . str ( fixed );
+    vector<CDate> loop ( count, date );
+    for ( int i = 0; i < count && iss >> loop[i]; ++i )
+    {
+    }
+    printRate ( "operator >> loop", count, start );
+
+    start = chrono::steady_clock::now ();
+    vector<CDate> batch ( count, date );
+    vector<size_t> invalid;
+    CDate::parseBatch ( fixed . data (), fixed . size (), batch . data (), invalid );
+    printRate ( "CDate::parseBatch", count, start );
+
+    assert ( invalid . empty () && equal ( loop . begin (), loop . end (), batch . begin () ) );
 }
 
-bool CDate::operator>(CDate other) const
+/**
+ * @brief Compares the batch kernels with loops over the scalar operators
+ */
+static void benchmarkBatchKernels ( void )
 {
-    return ( year  > other.year                           ||
-           ( year == other.year && month > other.month )  ||
-           ( year == other.year && month == other.month && day > other.day )
-    );
+    const int count = 1000000;
+    const CDate base ( 1990, 1, 1 );
+    vector<CDate> dates, others;
+    vector<int> offsets ( count );
+    for ( int i = 0; i < count; ++i )
+    {
+        dates . push_back ( base + i % 20000 );
+        others . push_back ( base + (int) ( i * 7919LL % 20000 ) );
+        offsets[i] = i % 731 - 365;
+    }
+
+    // Outputs are allocated up front, so that only the loops are measured
+    vector<CDate> scalar ( dates ), shifted ( dates ), scalarCivil, civil ( count, base );
+    vector<int> scalarDiff ( count ), diff ( count ), years ( count ), months ( count ), days ( count );
+    scalarCivil . reserve ( count );
+
+    auto start = chrono::steady_clock::now ();
+    for ( int i = 0; i < count; ++i )
+    {
+        scalar[i] = scalar[i] + offsets[i];
+    }
+    printRate ( "operator + loop", count, start );
+
+    start = chrono::steady_clock::now ();
+    CDate::addDays ( shifted, offsets );
+    printRate ( "CDate::addDays", count, start );
+    assert ( scalar == shifted );
+
+    start = chrono::steady_clock::now ();
+    for ( int i = 0; i < count; ++i )
+    {
+        scalarDiff[i] = dates[i] - others[i];
+    }
+    printRate ( "operator - loop", count, start );
+
+    start = chrono::steady_clock::now ();
+    CDate::diffDays ( dates, others, diff );
+    printRate ( "CDate::diffDays", count, start );
+    assert ( scalarDiff == diff );
+
+    start = chrono::steady_clock::now ();
+    CDate::toCivil ( dates, years, months, days );
+    printRate ( "CDate::toCivil", count, start );
+
+    start = chrono::steady_clock::now ();
+    for ( int i = 0; i < count; ++i )
+    {
+        scalarCivil . emplace_back ( years[i], months[i], days[i] );
+    }
+    printRate ( "CDate constructor loop", count, start );
+
+    vector<unsigned char> valid ( count );
+    start = chrono::steady_clock::now ();
+    size_t invalid = CDate::fromCivil ( years, months, days, civil, valid );
+    printRate ( "CDate::fromCivil", count, start );
+    assert ( invalid == 0 && civil == dates && scalarCivil == dates );
 }
 
-bool CDate::operator<(CDate other) const
+/**
+ * @brief Packs dates to a column, saves and maps its image and sorts packed dates against full ones
+ */
+static void benchmarkDateColumn ( void )
 {
-    return ( !( *this > other ) && !( *this == other ) );
+    const int count = 1000000;
+    const CDate base ( 1900, 1, 1 );
+    vector<CDate> dates;
+    for ( int i = 0; i < count; ++i )
+    {
+        dates . push_back ( base + (int) ( i * 7919LL % 47339 ) );
+    }
+
+    auto start = chrono::steady_clock::now ();
+    CDateColumn column;
+    column . append ( dates );
+    printRate ( "CDateColumn::append", count, start );
+
+    ostringstream image;
+    column . save ( image );
+    string imageData = image . str ();
+
+    start = chrono::steady_clock::now ();
+    CDateColumn mapped;
+    bool ok = CDateColumn::map ( imageData . data (), imageData . size (), mapped );
+    vector<CDate> unpacked ( count, base );
+    mapped . unpack ( unpacked );
+    printRate ( "CDateColumn::map + unpack", count, start );
+    assert ( ok && unpacked == dates );
+
+    start = chrono::steady_clock::now ();
+    sort ( dates . begin (), dates . end () );
+    printRate ( "sort CDate", count, start );
+
+    start = chrono::steady_clock::now ();
+    vector<CPackedDate> packed ( column . packed () . begin (), column . packed () . end () );
+    sort ( packed . begin (), packed . end () );
+    printRate ( "sort CPackedDate", count, start );
+    assert ( packed . front () . unpack ( column . base () ) == dates . front () && packed . back () . unpack ( column . base () ) == dates . back () );
+
+    cout << "bytes per date: CDate " << sizeof ( CDate ) << ", CPackedDate " << sizeof ( CPackedDate )
+         << ", image " << imageData . size () << " bytes" << endl;
 }
 
-bool CDate::operator<=(CDate other) const
+/**
+ * @brief Sums distances of days from the first one by a loop of ++. The loops measured are in functions with external
+ *        linkage, GCC considers static functions called only from main to run once and doesn't inline calls there
+ * @param from First date
+ * @param to Last date, inclusive
+ * @return Sum of the distances
+ */
+long long sumDays ( CDate from, CDate to )
 {
-    return ( !( *this > other ) );
+    long long sum = 0;
+    for ( CDate date = from; date <= to; ++date )
+    {
+        sum += date - from;
+    }
+    return sum;
 }
 
-bool CDate::operator>=(CDate other) const
+/**
+ * @brief Sums distances of dates of a range from a date
+ * @param range Range of dates
+ * @param from Date the distances are measured from
+ * @return Sum of the distances
+ */
+long long sumRange ( const CDateRange & range, CDate from )
 {
-    return ( !( *this < other ) );
+    long long sum = 0;
+    for ( CDate date : range )
+    {
+        sum += date - from;
+    }
+    return sum;
 }
 
-bool CDate::isLeapYear(int year) const
+/**
+ * @brief Compares iteration over 10 years of days and months by CDateRange with loops of ++ and constructors
+ */
+static void benchmarkDateRange ( void )
 {
-    if ( year % 4   != 0 ) { return false; }
-    if ( year % 100 != 0 ) { return true;  }
-    if ( year % 400 != 0 ) { return false; }
-    return true;
+    const int rounds = 1000;
+    const CDate from ( 2015, 1, 31 ), to ( 2024, 12, 31 );
+    const size_t days = ( to - from + 1 ) * (size_t) rounds;
+    long long checksum = 0;
+
+    auto start = chrono::steady_clock::now ();
+    for ( int r = 0; r < rounds; ++r )
+    {
+        checksum += sumDays ( from, to );
+    }
+    printRate ( "++ loop ( days )", days, start );
+
+    start = chrono::steady_clock::now ();
+    for ( int r = 0; r < rounds; ++r )
+    {
+        checksum -= sumRange ( CDateRange ( from, to ), from );
+    }
+    printRate ( "CDateRange ( days )", days, start );
+
+    // Months by hand, the day of the month is clamped to the last day
+    const size_t months = 120 * (size_t) rounds * 100;
+    start = chrono::steady_clock::now ();
+    for ( int r = 0; r < rounds * 100; ++r )
+    {
+        for ( int month = 0; month < 120; ++month )
+        {
+            int year = 2015 + month / 12, current = month % 12 + 1;
+            CDate first ( year, current, 1 );
+            CDate next = current == 12 ? CDate ( year + 1, 1, 1 ) : CDate ( year, current + 1, 1 );
+            checksum += min ( first + 30, next - 1 ) - from;
+        }
+    }
+    printRate ( "constructor loop ( months )", months, start );
+
+    start = chrono::steady_clock::now ();
+    for ( int r = 0; r < rounds * 100; ++r )
+    {
+        checksum -= sumRange ( CDateRange ( from, to, 1, CDateRange::MONTHS ), from );
+    }
+    printRate ( "CDateRange ( months )", months, start );
+    assert ( checksum == 0 );
 }
 
-int CDate::daysInMonth(int month, int year) const
+/**
+ * @brief Builds a business calendar over the whole supported range and compares its queries with loops of ++
+ */
+static void benchmarkBusinessCalendar ( void )
 {
-    switch ( month )
+    vector<CDate> holidays;
+    for ( int year = 1; year <= 9999; ++year )
+    {
+        for ( auto [ month, day ] : { pair ( 1, 1 ), pair ( 5, 1 ), pair ( 5, 8 ), pair ( 7, 5 ), pair ( 9, 28 ), pair ( 10, 28 ), pair ( 11, 17 ), pair ( 12, 24 ), pair ( 12, 25 ), pair ( 12, 26 ) } )
+        {
+            holidays . push_back ( CDate ( year, month, day ) );
+        }
+    }
+
+    // Rate in days of the calendar
+    auto start = chrono::steady_clock::now ();
+    CBusinessCalendar calendar ( CDate ( 1, 1, 1 ), CDate ( 9999, 12, 31 ), holidays );
+    printRate ( "CBusinessCalendar", CDate ( 9999, 12, 31 ) - CDate ( 1, 1, 1 ) + 1, start );
+
+    const int count = 1000000, loops = 10000;
+    vector<CDate> dates;
+    vector<int> terms;
+    for ( int i = 0; i < count; ++i )
+    {
+        dates . push_back ( CDate ( 1990, 1, 1 ) + (int) ( i * 7919LL % 20000 ) );
+        terms . push_back ( i % 60 + 1 );
+    }
+
+    auto isWorking = [ & ] ( CDate date )
     {
-        case 1:
-        case 3:
-        case 5:
-        case 7:
-        case 8:
-        case 10:
-        case 12: return 31;
-        case 4:
-        case 6:
-        case 9:
-        case 11: return 30;
-        case 2: if (isLeapYear( year )) { return 29; } else { return 28; }
-        default: return 0;
+        return date . weekday () < 6 && ! binary_search ( holidays . begin (), holidays . end (), date );
+    };
+    sort ( holidays . begin (), holidays . end () );
+
+    start = chrono::steady_clock::now ();
+    vector<CDate> naive;
+    for ( int i = 0; i < loops; ++i )
+    {
+        CDate date = dates[i];
+        for ( int left = terms[i]; left; )
+        {
+            left -= isWorking ( ++ date );
+        }
+        naive . push_back ( date );
     }
+    printRate ( "++ loop ( working days )", loops, start );
+
+    start = chrono::steady_clock::now ();
+    vector<CDate> due ( count, dates[0] );
+    calendar . addBusinessDays ( dates, terms, due );
+    printRate ( "addBusinessDays", count, start );
+    assert ( equal ( naive . begin (), naive . end (), due . begin () ) );
+
+    start = chrono::steady_clock::now ();
+    vector<int> between ( count );
+    calendar . businessDaysBetween ( dates, due, between );
+    printRate ( "businessDaysBetween", count, start );
+    assert ( between == terms );
 }
 
-bool CDate::validDate(CDate date) const
+/**
+ * @brief Compares std::sort with the radix sort of dates
+ */
+static void benchmarkSortDates ( void )
 {
-    return ( date.month >= 1 && date.month <= 12 && date.day >= 1 && date.day <= daysInMonth( date.month, date.year ) );
+    const int count = 10000000;
+    vector<CDate> dates;
+    unsigned seed = 1;
+    for ( int i = 0; i < count; ++i )
+    {
+        seed = seed * 1103515245 + 12345;
+        dates . push_back ( CDate ( 1, 1, 1 ) + (int) ( seed % 3652059 ) );
+    }
+
+    vector<CDate> expected ( dates );
+    auto start = chrono::steady_clock::now ();
+    sort ( expected . begin (), expected . end () );
+    printRate ( "std::sort", count, start );
+
+    vector<unsigned> threads = { 1 };
+    if ( thread::hardware_concurrency () > 1 )
+    {
+        threads . push_back ( thread::hardware_concurrency () );
+    }
+    for ( unsigned t : threads )
+    {
+        vector<CDate> sorted ( dates );
+        start = chrono::steady_clock::now ();
+        CDate::sortDates ( sorted, t );
+        printRate ( ( "CDate::sortDates ( " + to_string ( t ) + " )" ) . c_str (), count, start );
+        assert ( sorted == expected );
+    }
 }
 
-int CDate::daysFromStart(CDate date) const
+/**
+ * @brief Measures the scalar operators of CDate, results are stored or summed, so that the compiler keeps the loops
+ */
+static void benchmarkOperators ( void )
 {
-    int result = 0;
-    for ( int i = 2000; i < date.year ; ++i ) {
-        if ( isLeapYear( i ) ) { result += 366 ;}
-        else { result += 365 ;}
+    const int count = 10000000;
+    long long checksum = 0;
+
+    auto start = chrono::steady_clock::now ();
+    for ( int i = 0; i < count; ++i )
+    {
+        checksum += CDate ( 1990 + i % 40, i % 12 + 1, i % 28 + 1 ) - CDate ( 1990, 1, 1 );
+    }
+    printRate ( "constructor", count, start );
+
+    const int invalidCount = 100000;
+    start = chrono::steady_clock::now ();
+    for ( int i = 0; i < invalidCount; ++i )
+    {
+        try
+        {
+            checksum += CDate ( 1990 + i % 40, 2, 30 ) - CDate ( 1990, 1, 1 );
+        }
+        catch ( const InvalidDateException & )
+        {
+            ++checksum;
+        }
     }
+    printRate ( "constructor ( invalid )", invalidCount, start );
 
-    for ( int i = 1; i < date.month ; ++i ) {
-        result += daysInMonth( i, date.year );
+    vector<CDate> dates;
+    for ( int i = 0; i < count; ++i )
+    {
+        dates . push_back ( CDate ( 1900, 1, 1 ) + (int) ( i * 7919LL % 73000 ) );
     }
 
-    result += date.day;
-    return result;
+    vector<CDate> shifted ( dates );
+    for ( int offset : { 1, 30, 365, 36500, 1000000 } )
+    {
+        start = chrono::steady_clock::now ();
+        for ( int i = 0; i < count; ++i )
+        {
+            shifted[i] = dates[i] + offset;
+        }
+        checksum += shifted[count / 2] - dates[count / 2];
+        printRate ( ( "operator + ( " + to_string ( offset ) + " )" ) . c_str (), count, start );
+    }
+
+    for ( int years : { 1, 10, 100, 1000 } )
+    {
+        const CDate other = CDate ( 1900, 1, 1 ) + years * 365;
+        start = chrono::steady_clock::now ();
+        for ( CDate date : dates )
+        {
+            checksum += date - other;
+        }
+        printRate ( ( "operator - ( " + to_string ( years ) + " years )" ) . c_str (), count, start );
+    }
+
+    shifted = dates;
+    start = chrono::steady_clock::now ();
+    for ( CDate & date : shifted )
+    {
+        ++ date;
+    }
+    for ( CDate & date : shifted )
+    {
+        date --;
+    }
+    printRate ( "++ and --", 2 * (size_t) count, start );
+    assert ( shifted == dates );
+
+    start = chrono::steady_clock::now ();
+    for ( int i = 1; i < count; ++i )
+    {
+        CDate x = dates[i - 1], y = dates[i];
+        checksum += ( x == y ) + ( x != y ) + ( x < y ) + ( x <= y ) + ( x > y ) + ( x >= y ) + ( ( x <=> y ) < 0 );
+    }
+    printRate ( "all comparisons", count, start );
+
+    cout << "checksum " << checksum << endl;
 }
+#endif /* BENCHMARK */
+
+/**
+ * @brief Compares every date of the supported range with a plain day by day walk of the civil calendar
+ */
+static void testAllDates ( void )
+{
+    const int lengths[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    // Three numbers of the full int range ( 11 characters each ), two dashes and the terminating zero
+    const size_t textSize = 3 * 11 + 2 + 1;
+    const CDate start ( 1, 1, 1 );
+    int serial = 0, weekday = 1;
+    CDate previous = start;
+
+    for ( int year = 1; year <= 9999; ++year )
+    {
+        bool leap = ( year % 4 == 0 && year % 100 != 0 ) || year % 400 == 0;
+        for ( int month = 1; month <= 12; ++month )
+        {
+            int length = lengths[month - 1] + ( month == 2 && leap );
+            for ( int day = 1; day <= length; ++day, ++serial, weekday = weekday % 7 + 1 )
+            {
+                CDate date ( year, month, day );
+                assert ( date == start + serial && date - start == serial && date . weekday () == weekday );
+                assert ( serial == 0 || ( date > previous && date - 1 == previous && ++ CDate ( previous ) == date ) );
 
+                char expected[textSize], buffer[CDate::MAX_CHARS];
+                snprintf ( expected, sizeof ( expected ), "%d-%02d-%02d", year, month, day );
+                assert ( string_view ( buffer, date . toChars ( buffer ) - buffer ) == expected );
+                CDate parsed = start;
+                assert ( CDate::parse ( expected, parsed ) && parsed == date );
+                previous = date;
+            }
+
+            // The day after the end of the month is invalid
+            char invalid[textSize];
+            snprintf ( invalid, sizeof ( invalid ), "%d-%02d-%02d", year, month, length + 1 );
+            CDate parsed = start;
+            assert ( ! CDate::parse ( invalid, parsed ) && parsed == start );
+        }
+    }
+    assert ( previous == CDate ( 9999, 12, 31 ) && serial == 3652059 );
+}
 
-#ifndef __PROGTEST__
 int main ( void )
 {
     ostringstream oss;
@@ -477,6 +2697,380 @@ int main ( void )
     oss . str ("");
     oss << d;
     assert ( oss . str () == "2000-02-29" );
+
+    CDate first ( 2000, 1, 1 );
+    CDate last ( 2030, 12, 31 );
+    assert ( first + 11322 == last );
+    assert ( last - 11322 == first );
+    assert ( last - first == 11322 && first - last == 11322 );
+    assert ( CDate ( 2000, 3, 1 ) - 1 == CDate ( 2000, 2, 29 ) );
+    assert ( CDate ( 2025, 3, 1 ) - CDate ( 2024, 2, 28 ) == 367 );
+    assert ( ++ CDate ( 2029, 12, 31 ) == CDate ( 2030, 1, 1 ) );
+    assert ( -- CDate ( 2030, 1, 1 ) == CDate ( 2029, 12, 31 ) );
+    assert ( CDate ( 2010, 5, 17 ) + ( -3000 ) == CDate ( 2010, 5, 17 ) - 3000 );
+    oss . str ("");
+    oss << CDate ( 1, 1, 1 ) << " " << CDate ( 9999, 12, 31 ) << " " << CDate ( 1582, 10, 15 ) - 1;
+    assert ( oss . str () == "1-01-01 9999-12-31 1582-10-14" );
+    oss . str ("");
+    oss << CDate ( 2030, 6, 15 ) - 10000;
+    assert ( oss . str () == "2003-01-28" );
+    for ( int year : { 0, 10000, -5 } )
+    {
+        try
+        {
+            CDate f ( year, 1, 1 );
+            assert ( "No exception thrown!" == nullptr );
+        }
+        catch ( const InvalidDateException & )
+        {
+        }
+    }
+    iss . clear ();
+    iss . str ( "10000-01-01" );
+    assert ( ! ( iss >> d ) );
+    iss . clear ();
+    iss . str ( "1620-02-29" );
+    assert ( ( iss >> d ) && d == CDate ( 1620, 2, 29 ) );
+
+    iss . clear ();
+    iss . str ( "  2001-02-03 2001-02-04x2001-13-01" );
+    assert ( ( iss >> a >> b ) && a == CDate ( 2001, 2, 3 ) && b == CDate ( 2001, 2, 4 ) );
+    assert ( iss . get () == 'x' );
+    assert ( ! ( iss >> a ) && a == CDate ( 2001, 2, 3 ) );
+    iss . clear ();
+    iss . str ( "2001/02/03" );
+    assert ( ! ( iss >> a ) && a == CDate ( 2001, 2, 3 ) );
+    // Whitespace before fields and separators and signs of fields are accepted as by extraction of numbers
+    iss . clear ();
+    iss . str ( "+2000-01-01 2000 -01-02 2000- 01-03 2000-01- 04 2000-+01-05" );
+    assert ( ( iss >> a >> b >> c >> d ) && a == CDate ( 2000, 1, 1 ) && b == CDate ( 2000, 1, 2 ) && c == CDate ( 2000, 1, 3 ) && d == CDate ( 2000, 1, 4 ) );
+    assert ( ( iss >> a ) && a == CDate ( 2000, 1, 5 ) && iss . eof () );
+    iss . clear ();
+    iss . str ( "2000 -01-06" );
+    assert ( ! ( iss >> noskipws >> a ) && a == CDate ( 2000, 1, 5 ) );
+    iss >> skipws;
+    iss . clear ();
+    iss . str ( "2000--01-01" );
+    assert ( ! ( iss >> a ) && a == CDate ( 2000, 1, 5 ) );
+    // A failing date is consumed as far as by the extractions, separators are checked after the day
+    iss . clear ();
+    iss . str ( "2000/01/01 rest" );
+    assert ( ! ( iss >> a ) && ! iss . eof () && a == CDate ( 2000, 1, 5 ) );
+    iss . clear ();
+    assert ( iss . tellg () == 10 );
+    iss . str ( "8938805+3--9" );
+    assert ( ! ( iss >> a ) && iss . eof () );
+    iss . clear ();
+    iss . str ( "-2147483648-01-01 x" );
+    assert ( ! ( iss >> a ) && ! iss . eof () );
+    iss . clear ();
+    assert ( iss . tellg () == 17 );
+
+    const char text[] = "2024-02-29;2023-02-29;1999-12-31";
+    CDate parsed ( 2000, 1, 1 );
+    auto result = CDate::fromChars ( text, text + sizeof ( text ) - 1, parsed );
+    assert ( result . ec == errc () && result . ptr == text + 10 && parsed == CDate ( 2024, 2, 29 ) );
+    result = CDate::fromChars ( text + 11, text + sizeof ( text ) - 1, parsed );
+    assert ( result . ec == errc::invalid_argument && result . ptr == text + 11 && parsed == CDate ( 2024, 2, 29 ) );
+    assert ( CDate::parse ( string_view ( text + 22, 10 ), parsed ) && parsed == CDate ( 1999, 12, 31 ) );
+    assert ( ! CDate::parse ( string_view ( text, 11 ), parsed ) && parsed == CDate ( 1999, 12, 31 ) );
+    assert ( ! CDate::parse ( "2000-01", parsed ) );
+    assert ( ! CDate::parse ( "2000-01-", parsed ) );
+    assert ( ! CDate::parse ( "", parsed ) );
+    assert ( ! CDate::parse ( "99999999999-01-01", parsed ) );
+    assert ( CDate::parse ( "0800-1-9", parsed ) && parsed == CDate ( 800, 1, 9 ) );
+    // Stricter than operator >>
+    assert ( ! CDate::parse ( " 2000-01-01", parsed ) && ! CDate::parse ( "+2000-01-01", parsed ) );
+
+    char buffer[CDate::MAX_CHARS];
+    assert ( string ( buffer, CDate ( 2030, 12, 1 ) . toChars ( buffer ) ) == "2030-12-01" );
+    assert ( string ( buffer, ( CDate ( 1, 1, 1 ) - 1 ) . toChars ( buffer ) ) == "0-12-31" );
+
+    const char batch[] = "2024-02-29\n2023-02-29\n1999-12-31\n20x0-01-01\n0000-01-01\n2000-13-01\n2000/01/01\n9999-12-31\n2000-0";
+    CDate parsedBatch[9] = { a, a, a, a, a, a, a, a, a };
+    vector<size_t> invalid;
+    assert ( CDate::parseBatch ( batch, sizeof ( batch ) - 1, parsedBatch, invalid ) == 9 );
+    assert ( invalid == vector<size_t> ( { 1, 3, 4, 5, 6, 8 } ) );
+    assert ( parsedBatch[0] == CDate ( 2024, 2, 29 ) && parsedBatch[1] == a && parsedBatch[2] == CDate ( 1999, 12, 31 ) );
+    assert ( parsedBatch[7] == CDate ( 9999, 12, 31 ) && parsedBatch[8] == a );
+    invalid . clear ();
+    assert ( CDate::parseBatch ( batch, 21, parsedBatch, invalid ) == 2 && invalid == vector<size_t> ( { 1 } ) );
+    assert ( CDate::parseBatch ( batch, 0, parsedBatch, invalid ) == 0 && invalid . size () == 1 );
+    // Long enough for 16 entries per step with AVX2
+    string longBatch;
+    for ( int i = 0; i < 40; ++i )
+    {
+        char entry[CDate::MAX_CHARS];
+        longBatch . append ( entry, ( CDate ( 1999, 12, 25 ) + 17 * i ) . toChars ( entry ) );
+        longBatch . push_back ( '\n' );
+    }
+    longBatch . replace ( 3 * CDate::BATCH_STRIDE, 10, "2001-02-29" );
+    longBatch . replace ( 17 * CDate::BATCH_STRIDE + 5, 2, "13" );
+    longBatch[30 * CDate::BATCH_STRIDE + 4] = '/';
+    vector<CDate> longParsed ( 40, a );
+    invalid . clear ();
+    assert ( CDate::parseBatch ( longBatch . data (), longBatch . size (), longParsed . data (), invalid ) == 40 );
+    assert ( invalid == vector<size_t> ( { 3, 17, 30 } ) && longParsed[3] == a && longParsed[17] == a && longParsed[30] == a );
+    assert ( longParsed[0] == CDate ( 1999, 12, 25 ) && longParsed[4] == CDate ( 2000, 3, 2 ) && longParsed[39] == CDate ( 1999, 12, 25 ) + 17 * 39 );
+
+    CDate column[4] = { CDate ( 2000, 1, 31 ), CDate ( 2024, 2, 28 ), CDate ( 1, 1, 1 ), CDate ( 9999, 12, 31 ) };
+    const CDate shifted[4] = { CDate ( 2000, 3, 1 ), CDate ( 2024, 2, 28 ), CDate ( 1, 1, 1 ), CDate ( 2000, 1, 1 ) };
+    const int offsets[4] = { 30, 1, 365, -3000000 };
+    int years[4], months[4], days[4], diff[4];
+    signed char order[4];
+    CDate::addDays ( column, offsets );
+    assert ( column[0] == CDate ( 2000, 3, 1 ) && column[1] == CDate ( 2024, 2, 29 ) && column[2] == CDate ( 2, 1, 1 ) );
+    assert ( column[3] == CDate ( 9999, 12, 31 ) - 3000000 );
+    CDate::diffDays ( column, shifted, diff );
+    assert ( diff[0] == 0 && diff[1] == 1 && diff[2] == 365 && diff[3] == CDate ( 2000, 1, 1 ) - column[3] );
+    CDate::compare ( column, shifted, order );
+    assert ( order[0] == 0 && order[1] == 1 && order[2] == 1 && order[3] == -1 );
+    CDate::toCivil ( column, years, months, days );
+    assert ( years[1] == 2024 && months[1] == 2 && days[1] == 29 && years[2] == 2 && months[2] == 1 && days[2] == 1 );
+    months[0] = 13;
+    days[2] = 0;
+    years[3] = 10000;
+    CDate converted[4] = { a, a, a, a };
+    unsigned char valid[4];
+    assert ( CDate::fromCivil ( years, months, days, converted, valid ) == 3 );
+    assert ( ! valid[0] && valid[1] && ! valid[2] && ! valid[3] && converted[0] == a && converted[1] == CDate ( 2024, 2, 29 ) && converted[3] == a );
+    diff[2] = -1;
+    CDate::diffDays ( span<const CDate> ( column, 2 ), shifted, diff );
+    assert ( diff[0] == 0 && diff[1] == 1 && diff[2] == -1 );
+
+    CDateColumn dateColumn;
+    dateColumn . push_back ( CDate ( 2030, 12, 31 ) );
+    dateColumn . append ( span<const CDate> ( shifted, 2 ) );
+    dateColumn . push_back ( shifted[3] );
+    assert ( dateColumn . size () == 4 && dateColumn[0] == CDate ( 2030, 12, 31 ) && dateColumn[2] == CDate ( 2024, 2, 28 ) );
+    assert ( dateColumn . packed ()[3] < dateColumn . packed ()[1] && dateColumn . packed ()[3] == CPackedDate () );
+    try
+    {
+        dateColumn . append ( column );
+        assert ( "No exception thrown!" == nullptr );
+    }
+    catch ( const InvalidDateException & )
+    {
+    }
+    try
+    {
+        dateColumn . push_back ( CDate ( 1851, 1, 1 ) );
+        assert ( "No exception thrown!" == nullptr );
+    }
+    catch ( const InvalidDateException & )
+    {
+    }
+    assert ( dateColumn . size () == 4 && dateColumn . base () == CDate ( 2000, 1, 1 ) );
+    dateColumn . unpack ( converted );
+    assert ( converted[0] == CDate ( 2030, 12, 31 ) && converted[1] == CDate ( 2000, 3, 1 ) && converted[3] == CDate ( 2000, 1, 1 ) );
+
+    CDateColumn historicColumn;
+    historicColumn . push_back ( CDate ( 1750, 7, 28 ) );
+    historicColumn . push_back ( CDate ( 1620, 2, 29 ) );
+    historicColumn . push_back ( CDate ( 1685, 3, 21 ) );
+    assert ( historicColumn . base () == CDate ( 1620, 2, 29 ) && historicColumn[0] == CDate ( 1750, 7, 28 ) && historicColumn[1] == CDate ( 1620, 2, 29 ) );
+    assert ( historicColumn . packed ()[1] < historicColumn . packed ()[2] && historicColumn . packed ()[2] < historicColumn . packed ()[0] );
+    try
+    {
+        historicColumn . push_back ( CDate ( 1800, 1, 1 ) );
+        assert ( "No exception thrown!" == nullptr );
+    }
+    catch ( const InvalidDateException & )
+    {
+    }
+    historicColumn . push_back ( CDate ( 1799, 6, 1 ) );
+    assert ( historicColumn . size () == 4 && historicColumn[3] == CDate ( 1799, 6, 1 ) && historicColumn[2] == CDate ( 1685, 3, 21 ) );
+
+    ostringstream image;
+    dateColumn . save ( image );
+    string imageData = image . str ();
+    assert ( imageData . size () == CDateColumn::HEADER_SIZE + 4 * sizeof ( CPackedDate ) );
+    CDateColumn mappedColumn;
+    assert ( CDateColumn::map ( imageData . data (), imageData . size (), mappedColumn ) && mappedColumn . isMapped () );
+    assert ( mappedColumn . size () == 4 && mappedColumn . packed () . data () == (const CPackedDate *) ( imageData . data () + CDateColumn::HEADER_SIZE ) );
+    assert ( mappedColumn[0] == CDate ( 2030, 12, 31 ) && mappedColumn[3] == CDate ( 2000, 1, 1 ) );
+    mappedColumn . push_back ( CDate ( 1900, 2, 28 ) );
+    assert ( ! mappedColumn . isMapped () && mappedColumn . size () == 5 && mappedColumn[4] == CDate ( 1900, 2, 28 ) && mappedColumn[0] == dateColumn[0] );
+    assert ( mappedColumn . base () == CDate ( 1900, 2, 28 ) && mappedColumn[3] == CDate ( 2000, 1, 1 ) );
+    ostringstream historicImage;
+    historicColumn . save ( historicImage );
+    string historicData = historicImage . str ();
+    CDateColumn historicMapped;
+    assert ( CDateColumn::map ( historicData . data (), historicData . size (), historicMapped ) && historicMapped . base () == CDate ( 1620, 2, 29 ) );
+    assert ( historicMapped[0] == CDate ( 1750, 7, 28 ) && historicMapped[3] == CDate ( 1799, 6, 1 ) );
+    assert ( ! CDateColumn::map ( imageData . data (), imageData . size () - 1, mappedColumn ) && mappedColumn . size () == 5 );
+    imageData[0] = 'X';
+    assert ( ! CDateColumn::map ( imageData . data (), imageData . size (), mappedColumn ) );
+
+    assert ( ( CDate ( 2024, 2, 29 ) <=> CDate ( 2024, 3, 1 ) ) < 0 && ( CDate ( 2024, 2, 29 ) <=> CDate ( 2024, 2, 29 ) ) == 0 );
+    vector<CDate> unsorted, expected;
+    unsigned seed = 12345;
+    for ( int i = 0; i < 200000; ++i )
+    {
+        seed = seed * 1103515245 + 12345;
+        unsorted . push_back ( CDate ( 1, 1, 1 ) + (int) ( seed % 3652059 ) );
+    }
+    unsorted[7] = CDate ( 1, 1, 1 ) - 5000;
+    unsorted[8] = CDate ( 9999, 12, 31 ) + 5000;
+    expected = unsorted;
+    sort ( expected . begin (), expected . end () );
+    vector<CDate> sorted ( unsorted );
+    CDate::sortDates ( sorted );
+    assert ( sorted == expected );
+    sorted = unsorted;
+    CDate::sortDates ( sorted, 4 );
+    assert ( sorted == expected );
+    sorted . assign ( unsorted . begin (), unsorted . begin () + 100 );
+    CDate::sortDates ( sorted );
+    assert ( is_sorted ( sorted . begin (), sorted . end () ) );
+    sorted . assign ( 1000, CDate ( 2000, 1, 1 ) );
+    sorted[500] = CDate ( 1999, 12, 31 );
+    CDate::sortDates ( sorted );
+    assert ( sorted[0] == CDate ( 1999, 12, 31 ) && sorted[999] == CDate ( 2000, 1, 1 ) );
+
+    vector<CDate> schedule;
+    for ( CDate date : CDateRange ( CDate ( 2024, 1, 31 ), CDate ( 2024, 5, 31 ), 1, CDateRange::MONTHS ) )
+    {
+        schedule . push_back ( date );
+    }
+    assert ( schedule == vector<CDate> ( { CDate ( 2024, 1, 31 ), CDate ( 2024, 2, 29 ), CDate ( 2024, 3, 31 ), CDate ( 2024, 4, 30 ), CDate ( 2024, 5, 31 ) } ) );
+    CDateRange quarters ( CDate ( 2023, 11, 15 ), CDate ( 2025, 1, 1 ), 3, CDateRange::END_OF_MONTH );
+    schedule . clear ();
+    ranges::copy ( quarters, back_inserter ( schedule ) );
+    assert ( schedule == vector<CDate> ( { CDate ( 2023, 11, 30 ), CDate ( 2024, 2, 29 ), CDate ( 2024, 5, 31 ), CDate ( 2024, 8, 31 ), CDate ( 2024, 11, 30 ) } ) );
+    CDateRange weeks ( CDate ( 2024, 1, 1 ), CDate ( 2024, 12, 31 ), 1, CDateRange::WEEKS );
+    assert ( ranges::distance ( weeks ) == 53 && ranges::all_of ( weeks, [] ( CDate date ) { return date . weekday () == 1; } ) );
+    CDateRange newYear ( CDate ( 2023, 12, 30 ), CDate ( 2024, 1, 2 ) );
+    assert ( ranges::distance ( newYear ) == 4 && * ++ newYear . begin () == CDate ( 2023, 12, 31 ) );
+    assert ( ranges::count_if ( newYear, [] ( CDate date ) { return date . weekday () >= 6; } ) == 2 );
+    auto afterNewYear = newYear . begin ();
+    ++ afterNewYear;
+    assert ( afterNewYear != newYear . begin () && afterNewYear == ++ newYear . begin () && ++ ++ ++ afterNewYear == newYear . end () );
+    CDateRange empty ( CDate ( 2024, 1, 2 ), CDate ( 2024, 1, 1 ) );
+    assert ( empty . begin () == empty . end () );
+    CDateRange endOfMonth ( CDate ( 2024, 1, 15 ), CDate ( 2024, 1, 30 ), 1, CDateRange::END_OF_MONTH );
+    assert ( endOfMonth . begin () == endOfMonth . end () );
+    try
+    {
+        CDateRange ( CDate ( 2024, 1, 1 ), CDate ( 2024, 2, 1 ), 0 );
+        assert ( "No exception thrown!" == nullptr );
+    }
+    catch ( const invalid_argument & )
+    {
+    }
+
+    const CDate holidays[] = { CDate ( 2024, 1, 1 ), CDate ( 2024, 3, 29 ), CDate ( 2024, 4, 1 ), CDate ( 2024, 5, 1 ), CDate ( 2024, 5, 8 ), CDate ( 2023, 12, 25 ) };
+    CBusinessCalendar calendar ( CDate ( 2024, 1, 1 ), CDate ( 2024, 12, 31 ), holidays );
+    assert ( ! calendar . isBusinessDay ( CDate ( 2024, 4, 1 ) ) && ! calendar . isBusinessDay ( CDate ( 2024, 4, 6 ) ) && calendar . isBusinessDay ( CDate ( 2024, 4, 2 ) ) );
+    assert ( calendar . addBusinessDays ( CDate ( 2024, 3, 25 ), 14 ) == CDate ( 2024, 4, 16 ) );
+    assert ( calendar . addBusinessDays ( CDate ( 2024, 5, 4 ), -3 ) == CDate ( 2024, 4, 30 ) && calendar . addBusinessDays ( CDate ( 2024, 5, 4 ), 0 ) == CDate ( 2024, 5, 4 ) );
+    assert ( calendar . addBusinessDays ( CDate ( 2024, 3, 28 ), 1 ) == CDate ( 2024, 4, 2 ) && calendar . businessDaysBetween ( CDate ( 2024, 3, 28 ), CDate ( 2024, 4, 2 ) ) == 1 );
+    assert ( calendar . businessDaysBetween ( CDate ( 2024, 1, 1 ), CDate ( 2024, 12, 31 ) ) == 257 );
+    assert ( calendar . businessDaysBetween ( CDate ( 2024, 4, 16 ), CDate ( 2024, 3, 25 ) ) == -14 );
+    const CDate invoices[] = { CDate ( 2024, 3, 25 ), CDate ( 2024, 12, 20 ), CDate ( 2024, 5, 4 ) };
+    const int terms[] = { 14, 1, -3 };
+    CDate dueDates[3] = { a, a, a };
+    calendar . addBusinessDays ( invoices, terms, dueDates );
+    assert ( dueDates[0] == CDate ( 2024, 4, 16 ) && dueDates[1] == CDate ( 2024, 12, 23 ) && dueDates[2] == CDate ( 2024, 4, 30 ) );
+    int workingDays[3];
+    calendar . businessDaysBetween ( invoices, dueDates, workingDays );
+    assert ( workingDays[0] == 14 && workingDays[1] == 1 && workingDays[2] == -2 );
+    try
+    {
+        calendar . addBusinessDays ( CDate ( 2024, 12, 30 ), 2 );
+        assert ( "No exception thrown!" == nullptr );
+    }
+    catch ( const out_of_range & )
+    {
+    }
+    try
+    {
+        calendar . isBusinessDay ( CDate ( 2023, 12, 31 ) );
+        assert ( "No exception thrown!" == nullptr );
+    }
+    catch ( const out_of_range & )
+    {
+    }
+    calendar . setHolidays ( {} );
+    assert ( calendar . isBusinessDay ( CDate ( 2024, 4, 1 ) ) && calendar . businessDaysBetween ( CDate ( 2024, 1, 1 ), CDate ( 2024, 12, 31 ) ) == 261 );
+    CBusinessCalendar sixDays ( CDate ( 2024, 1, 1 ), CDate ( 2024, 1, 31 ), {}, 1u << 6 );
+    assert ( sixDays . addBusinessDays ( CDate ( 2024, 1, 5 ), 2 ) == CDate ( 2024, 1, 8 ) );
+
+    CDate g ( 2000, 1, 2 );
+    oss . str ( "" );
+    oss << date_format ( "%d.%m.%Y" ) << g << " " << date_format ( "%Y%m%d" ) << g;
+    assert ( oss . str () == "02.01.2000 20000102" );
+    oss . str ( "" );
+    oss << date_format ( "%%Y=%Y, 100%%" ) << g;
+    assert ( oss . str () == "%Y=2000, 100%" );
+    oss . str ( "" );
+    oss << date_format ( "%m/%d/%Y" ) << g;
+    assert ( ! ( oss << date_format ( "%Y-%q" ) ) );
+    oss . clear ();
+    assert ( ! ( oss << date_format ( "%Y-%m-%" ) ) );
+    oss . clear ();
+    oss << " " << g << " " << date_format ( "%Y-%m-%d" ) << g;
+    assert ( oss . str () == "01/02/2000 01/02/2000 2000-01-02" );
+    oss . str ( "" );
+    oss << date_format ( "It's year %Y of a very long format, which doesn't fit into one buffer of the output, month %m, day %d, year %Y again" ) << g;
+    assert ( oss . str () == "It's year 2000 of a very long format, which doesn't fit into one buffer of the output, month 01, day 02, year 2000 again" );
+    oss << date_format ( "%Y-%m-%d" );
+
+    iss . clear ();
+    iss . str ( "29.02.2024 29.02.2023 20240301" );
+    assert ( ( iss >> date_format ( "%d.%m.%Y" ) >> g ) && g == CDate ( 2024, 2, 29 ) );
+    assert ( ! ( iss >> g ) && g == CDate ( 2024, 2, 29 ) );
+    iss . clear ();
+    iss . ignore ( 1 );
+    assert ( ( iss >> date_format ( "%Y%m%d" ) >> g ) && g == CDate ( 2024, 3, 1 ) );
+    iss . clear ();
+    iss . str ( "2024-03-02" );
+    assert ( ! ( iss >> date_format ( "%Y-%m" ) ) );
+    iss . clear ();
+    assert ( ! ( iss >> date_format ( "%Y-%m-%d-%d" ) ) );
+    iss . clear ();
+    assert ( ! ( iss >> date_format ( "%Y-%m-%d%" ) ) );
+    iss . clear ();
+    assert ( ! ( iss >> g ) && g == CDate ( 2024, 3, 1 ) );
+    // Input ending inside a field or a literal sets eofbit as well
+    iss . clear ();
+    iss . str ( "29.02." );
+    assert ( ! ( iss >> date_format ( "%d.%m.%Y" ) >> g ) && iss . eof () && g == CDate ( 2024, 3, 1 ) );
+    iss . clear ();
+    iss . str ( "29.02" );
+    assert ( ! ( iss >> g ) && iss . eof () );
+    iss . clear ();
+    iss . str ( "29.02x2024" );
+    assert ( ! ( iss >> g ) && ! iss . eof () );
+    iss . clear ();
+    iss . str ( "2024-03-02" );
+    assert ( ( iss >> date_format ( "%Y-%m-%d" ) >> g ) && g == CDate ( 2024, 3, 2 ) );
+
+    // Formats survive copyfmt and are released by erase events ( destruction, overwrite by copyfmt )
+    auto source = make_unique<ostringstream> ();
+    ostringstream target, other;
+    * source << date_format ( "%d/%m/%Y" );
+    other << date_format ( "%Y|%m|%d" );
+    target . copyfmt ( other );
+    target . copyfmt ( * source );
+    source . reset ();
+    target << g << ' ';
+    other . copyfmt ( target );
+    target << date_format ( "%Y" ) << g << ' ';
+    other << g;
+    assert ( target . str () == "02/03/2024 2024 " && other . str () == "02/03/2024" );
+
+    testAllDates ();
+
+#ifdef BENCHMARK
+    benchmarkOperators ();
+    benchmarkParseFormat ();
+    benchmarkBatchKernels ();
+    benchmarkDateColumn ();
+    benchmarkDateRange ();
+    benchmarkBusinessCalendar ();
+    benchmarkSortDates ();
+#endif /* BENCHMARK */
     return EXIT_SUCCESS;
 
 }